@@ -21,39 +21,96 @@
 
 #include "s2ssedit/ignore_unused_variable_warning.hh"
 #include "s2ssedit/object.hh"
+#include "s2ssedit/objectset.hh"
 #include "s2ssedit/sslevelobjs.hh"
 #include "s2ssedit/ssobjfile.hh"
 #include "s2ssedit/sssegmentobjs.hh"
 
+#include <mdcomp/bigendian_io.hh>
+
 #include <algorithm>
+#include <istream>
 #include <memory>
-#include <set>
+#include <ostream>
 #include <string>
+#include <tuple>
+#include <type_traits>
 #include <utility>
+#include <vector>
 
 class ssobj_file;
 
 using ssobj_file_shared = std::shared_ptr<ssobj_file>;
-using object_set        = std::set<object>;
 
+// Identifies the concrete type of an action stored in the undo history,
+// which dispatches on it instead of using virtual calls.
+enum class ActionTag : uint8_t {
+    eAlterSelection = 0,
+    eDeleteSelection,
+    eInsertObjects,
+    eMoveObjects,
+    eShiftObjects,
+    eInsertObjectsEx,
+    eAlterSegment,
+    eDeleteSegment,
+    eCutSegment,
+    eInsertSegment,
+    eMoveSegment,
+    eDeleteStage,
+    eInsertStage,
+    eMoveStage
+};
+
+// Base of all actions. Actions are not polymorphic: each one provides
+//     void apply(ssobj_file_shared const& ss, object_set* sel);
+//     void revert(ssobj_file_shared const& ss, object_set* sel);
+//     MergeResult merge(<same action> const& other);
+//     size_t memory_usage() const noexcept;
+//     void write(std::ostream& out) const;
+// as well as a tag and a constructor reading back what write saved, and is
+// called through visit_action.
 class abstract_action {
 public:
     enum MergeResult { eNoMerge = 0, eMergedActions = 1, eDeleteAction = -1 };
+
+    // Default for actions that never merge.
+    template <typename Act>
+    MergeResult merge(Act const& other) {
+        ignore_unused_variable_warning(other);
+        return eNoMerge;
+    }
+
+protected:
+    // Helpers for saving actions to the edit journal.
+    static void write_int(std::ostream& out, int value) {
+        BigEndian::Write4(out, static_cast<uint32_t>(value));
+    }
+    static int read_int(std::istream& in) {
+        return static_cast<int32_t>(BigEndian::Read4(in));
+    }
+    static void write_objects(std::ostream& out, object_set const& objs) {
+        BigEndian::Write4(out, uint32_t(objs.size()));
+        for (auto const& elem : objs) {
+            BigEndian::Write4(out, elem.get_key());
+        }
+    }
+    static object_set read_objects(std::istream& in) {
+        size_t const        count = BigEndian::Read4(in);
+        std::vector<object> objs;
+        for (size_t ii = 0; ii < count && in.good(); ii++) {
+            objs.push_back(object::from_key(BigEndian::Read4(in)));
+        }
+        return object_set(std::move(objs));
+    }
+
     // Boilerplate
     abstract_action() noexcept                  = default;
     abstract_action(abstract_action const&)     = default;
     abstract_action(abstract_action&&) noexcept = default;
     abstract_action& operator=(abstract_action const&) = default;
     abstract_action& operator=(abstract_action&&) noexcept = default;
+    ~abstract_action() noexcept                            = default;
     // End boilerplate
-    virtual ~abstract_action() noexcept                        = default;
-    virtual void apply(ssobj_file_shared ss, object_set* sel)  = 0;
-    virtual void revert(ssobj_file_shared ss, object_set* sel) = 0;
-
-    virtual MergeResult merge(std::shared_ptr<abstract_action> const& other) {
-        ignore_unused_variable_warning(other);
-        return eNoMerge;
-    }
 };
 
 class alter_selection_action final : public abstract_action {
@@ -63,9 +120,16 @@ class alter_selection_action final : public abstract_action {
     sssegments::ObjectTypes type;
 
 public:
+    static constexpr const ActionTag tag = ActionTag::eAlterSelection;
+
+    explicit alter_selection_action(std::istream& in) {
+        objlist = read_objects(in);
+        stage   = read_int(in);
+        type    = sssegments::ObjectTypes(Read1(in));
+    }
     alter_selection_action(int s, sssegments::ObjectTypes t, object_set sel)
             : objlist(std::move(sel)), stage(s), type(t) {}
-    void apply(ssobj_file_shared ss, object_set* sel) override {
+    void apply(ssobj_file_shared const& ss, object_set* sel) {
         sslevels* currlvl = ss->get_stage(stage);
         if (sel != nullptr) {
             sel->clear();
@@ -80,7 +144,7 @@ class alter_selection_action final : public abstract_action {
             }
         }
     }
-    void revert(ssobj_file_shared ss, object_set* sel) override {
+    void revert(ssobj_file_shared const& ss, object_set* sel) {
         sslevels* currlvl = ss->get_stage(stage);
         for (auto const& elem : objlist) {
             sssegments* currseg = currlvl->get_segment(elem.get_segment());
@@ -91,29 +155,32 @@ class alter_selection_action final : public abstract_action {
             *sel = objlist;
         }
     }
-    MergeResult merge(std::shared_ptr<abstract_action> const& other) override {
-        std::shared_ptr<alter_selection_action> act
-                = std::dynamic_pointer_cast<alter_selection_action>(other);
-        if (!act) {
-            return eNoMerge;
-        }
-
-        if (objlist.size() != act->objlist.size()) {
+    MergeResult merge(alter_selection_action const& other) {
+        if (objlist.size() != other.objlist.size()) {
             return eNoMerge;
         }
 
-        if (!std::equal(objlist.begin(), objlist.end(), act->objlist.begin())) {
+        if (!std::equal(
+                    objlist.begin(), objlist.end(), other.objlist.begin())) {
             return eNoMerge;
         }
 
         for (auto const& elem : objlist) {
-            if (elem.get_type() != act->type) {
-                type = act->type;
+            if (elem.get_type() != other.type) {
+                type = other.type;
                 return eMergedActions;
             }
         }
         return eDeleteAction;
     }
+    void write(std::ostream& out) const {
+        write_objects(out, objlist);
+        write_int(out, stage);
+        Write1(out, type);
+    }
+    size_t memory_usage() const noexcept {
+        return sizeof(*this) + objlist.heap_size();
+    }
 };
 
 class delete_selection_action : public abstract_action {
@@ -122,10 +189,16 @@ class delete_selection_action : public abstract_action {
     int        stage;
 
 public:
+    static constexpr const ActionTag tag = ActionTag::eDeleteSelection;
+
+    explicit delete_selection_action(std::istream& in) {
+        objlist = read_objects(in);
+        stage   = read_int(in);
+    }
     friend class move_objects_action;
     delete_selection_action(int s, object_set sel)
             : objlist(std::move(sel)), stage(s) {}
-    void apply(ssobj_file_shared ss, object_set* sel) override {
+    void apply(ssobj_file_shared const& ss, object_set* sel) {
         if (sel != nullptr) {
             sel->clear();
         }
@@ -141,7 +214,7 @@ class delete_selection_action : public abstract_action {
             currseg->remove(elem.get_pos(), elem.get_angle());
         }
     }
-    void revert(ssobj_file_shared ss, object_set* sel) override {
+    void revert(ssobj_file_shared const& ss, object_set* sel) {
         sslevels* currlvl     = ss->get_stage(stage);
         int       numsegments = currlvl->num_segments();
 
@@ -158,18 +231,29 @@ class delete_selection_action : public abstract_action {
             *sel = objlist;
         }
     }
+    void write(std::ostream& out) const {
+        write_objects(out, objlist);
+        write_int(out, stage);
+    }
+    size_t memory_usage() const noexcept {
+        return sizeof(*this) + objlist.heap_size();
+    }
 };
 
 using cut_selection_action = delete_selection_action;
 
 class insert_objects_action final : public delete_selection_action {
 public:
+    static constexpr const ActionTag tag = ActionTag::eInsertObjects;
+
+    explicit insert_objects_action(std::istream& in)
+            : delete_selection_action(in) {}
     insert_objects_action(int s, object_set const& sel)
             : delete_selection_action(s, sel) {}
-    void apply(ssobj_file_shared ss, object_set* sel) override {
+    void apply(ssobj_file_shared const& ss, object_set* sel) {
         delete_selection_action::revert(ss, sel);
     }
-    void revert(ssobj_file_shared ss, object_set* sel) override {
+    void revert(ssobj_file_shared const& ss, object_set* sel) {
         delete_selection_action::apply(ss, sel);
     }
 };
@@ -178,30 +262,26 @@ using paste_objects_action = insert_objects_action;
 
 class move_objects_action : public abstract_action {
 private:
-    std::shared_ptr<delete_selection_action> from;
-    std::shared_ptr<paste_objects_action>    to;
+    delete_selection_action from;
+    paste_objects_action    to;
 
 public:
-    move_objects_action(int s, object_set const& del, object_set const& add)
-            : from(std::make_shared<delete_selection_action>(s, del)),
-              to(std::make_shared<paste_objects_action>(s, add)) {}
-    void apply(ssobj_file_shared ss, object_set* sel) final {
-        from->apply(ss, sel);
-        to->apply(ss, sel);
-    }
-    void revert(ssobj_file_shared ss, object_set* sel) override {
-        to->revert(ss, sel);
-        from->revert(ss, sel);
-    }
-    MergeResult merge(std::shared_ptr<abstract_action> const& other) override {
-        std::shared_ptr<move_objects_action> act
-                = std::dynamic_pointer_cast<move_objects_action>(other);
-        if (!act) {
-            return eNoMerge;
-        }
+    static constexpr const ActionTag tag = ActionTag::eMoveObjects;
 
-        object_set& list1 = to->objlist;
-        object_set& list2 = act->from->objlist;
+    explicit move_objects_action(std::istream& in) : from(in), to(in) {}
+    move_objects_action(int s, object_set const& del, object_set const& add)
+            : from(s, del), to(s, add) {}
+    void apply(ssobj_file_shared const& ss, object_set* sel) {
+        from.apply(ss, sel);
+        to.apply(ss, sel);
+    }
+    void revert(ssobj_file_shared const& ss, object_set* sel) {
+        to.revert(ss, sel);
+        from.revert(ss, sel);
+    }
+    MergeResult merge(move_objects_action const& other) {
+        object_set&       list1 = to.objlist;
+        object_set const& list2 = other.from.objlist;
         if (list1.size() != list2.size()) {
             return eNoMerge;
         }
@@ -213,22 +293,269 @@ class move_objects_action : public abstract_action {
         }
 
         if (std::equal(
-                    from->objlist.begin(), from->objlist.end(),
-                    act->to->objlist.begin(), ObjectMatchFunctor())) {
+                    from.objlist.begin(), from.objlist.end(),
+                    other.to.objlist.begin(), ObjectMatchFunctor())) {
             return eDeleteAction;
         }
 
-        list1 = act->to->objlist;
+        list1 = other.to.objlist;
         return eMergedActions;
     }
+    void write(std::ostream& out) const {
+        from.write(out);
+        to.write(out);
+    }
+    size_t memory_usage() const noexcept {
+        return sizeof(*this) + from.objlist.heap_size()
+               + to.objlist.heap_size();
+    }
+};
+
+// Moves a set of objects by a common offset. Only the source objects and
+// the offset are kept; objects that move differently (for example, because
+// they skip over a collision or wrap around) are kept as exceptions. Objects
+// overwritten at the destinations are recorded when applying and restored
+// on revert.
+class shift_objects_action final : public abstract_action {
+private:
+    object_set source;
+    int        stage;
+    int        dseg = 0, drow = 0, dangle = 0;
+    // Index in source and packed destination of the objects that do not move
+    // by the common offset, ordered by index.
+    std::vector<std::pair<uint32_t, uint32_t>> exceptions;
+    object_set                                 displaced;
+
+    object shifted(object const& obj) const {
+        return object(
+                obj.get_segment() + dseg, unsigned(obj.get_angle() + dangle),
+                unsigned(obj.get_pos() + drow), obj.get_type());
+    }
+    // Calls func(source, destination) for each object, in source order.
+    template <typename Func>
+    void for_each_move(Func func) const {
+        auto     exc   = exceptions.cbegin();
+        uint32_t index = 0;
+        for (auto const& elem : source) {
+            if (exc != exceptions.cend() && exc->first == index) {
+                func(elem, object::from_key(exc->second));
+                ++exc;
+            } else {
+                func(elem, shifted(elem));
+            }
+            index++;
+        }
+    }
+    std::vector<object> destinations() const {
+        std::vector<object> dests;
+        dests.reserve(source.size());
+        for_each_move([&dests](object const& src, object const& dst) {
+            ignore_unused_variable_warning(src);
+            dests.push_back(dst);
+        });
+        return dests;
+    }
+    // Picks the offset shared by most objects with a majority vote, and
+    // records the others as exceptions.
+    void encode(std::vector<object> const& dests) {
+        auto offset_of = [](object const& src, object const& dst) {
+            return std::make_tuple(
+                    dst.get_segment() - src.get_segment(),
+                    dst.get_pos() - src.get_pos(),
+                    (dst.get_angle() - src.get_angle()) & 0xff);
+        };
+        std::tuple<int, int, int> best{0, 0, 0};
+        size_t                    votes = 0;
+        auto                      dst   = dests.cbegin();
+        for (auto const& src : source) {
+            auto offset = offset_of(src, *dst++);
+            if (votes == 0) {
+                best  = offset;
+                votes = 1;
+            } else if (offset == best) {
+                votes++;
+            } else {
+                votes--;
+            }
+        }
+        std::tie(dseg, drow, dangle) = best;
+        exceptions.clear();
+        uint32_t index = 0;
+        dst            = dests.cbegin();
+        for (auto const& src : source) {
+            if (shifted(src).get_key() != dst->get_key()) {
+                exceptions.emplace_back(index, dst->get_key());
+            }
+            ++dst;
+            index++;
+        }
+        exceptions.shrink_to_fit();
+    }
+    static sssegments* find_segment(sslevels* currlvl, int seg) {
+        if (seg < 0 || size_t(seg) >= currlvl->num_segments()) {
+            return nullptr;
+        }
+        return currlvl->get_segment(size_t(seg));
+    }
+    // Objects are sorted by segment, so the segment only has to be looked
+    // up when it changes.
+    static void remove_all(sslevels* currlvl, object_set const& objs) {
+        int         lastseg = -1;
+        sssegments* currseg = nullptr;
+        for (auto const& elem : objs) {
+            if (elem.get_segment() != lastseg) {
+                lastseg = elem.get_segment();
+                currseg = find_segment(currlvl, lastseg);
+            }
+            if (currseg != nullptr) {
+                currseg->remove(elem.get_pos(), elem.get_angle());
+            }
+        }
+    }
+    static void insert_all(sslevels* currlvl, object_set const& objs) {
+        int         lastseg = -1;
+        sssegments* currseg = nullptr;
+        for (auto const& elem : objs) {
+            if (elem.get_segment() != lastseg) {
+                lastseg = elem.get_segment();
+                currseg = find_segment(currlvl, lastseg);
+            }
+            if (currseg != nullptr) {
+                currseg->update(
+                        elem.get_pos(), elem.get_angle(), elem.get_type(),
+                        true);
+            }
+        }
+    }
+
+public:
+    static constexpr const ActionTag tag = ActionTag::eShiftObjects;
+
+    explicit shift_objects_action(std::istream& in) {
+        source = read_objects(in);
+        stage  = read_int(in);
+        dseg   = read_int(in);
+        drow   = read_int(in);
+        dangle = read_int(in);
+        size_t const count = BigEndian::Read4(in);
+        for (size_t ii = 0; ii < count && in.good(); ii++) {
+            uint32_t const index = BigEndian::Read4(in);
+            uint32_t const key   = BigEndian::Read4(in);
+            exceptions.emplace_back(index, key);
+        }
+        displaced = read_objects(in);
+    }
+    // dests holds the destination of each object of src, in order.
+    shift_objects_action(
+            int s, object_set src, std::vector<object> const& dests)
+            : source(std::move(src)), stage(s) {
+        encode(dests);
+    }
+    void apply(ssobj_file_shared const& ss, object_set* sel) {
+        sslevels* currlvl = ss->get_stage(stage);
+        // Lift all objects first, so that objects moving into spots left by
+        // others are not taken as collisions.
+        remove_all(currlvl, source);
+        object_set moved;
+        moved.reserve(source.size());
+        displaced.clear();
+        int         lastseg = -1;
+        sssegments* currseg = nullptr;
+        for_each_move([&](object const& src, object const& dst) {
+            ignore_unused_variable_warning(src);
+            if (dst.get_segment() != lastseg) {
+                lastseg = dst.get_segment();
+                currseg = find_segment(currlvl, lastseg);
+            }
+            if (currseg == nullptr) {
+                return;
+            }
+            sssegments::ObjectTypes type;
+            if (currseg->exists(dst.get_pos(), dst.get_angle(), type)
+                && moved.count(dst) == 0) {
+                displaced.emplace(
+                        dst.get_segment(), dst.get_angle(), dst.get_pos(),
+                        type);
+            }
+            currseg->update(
+                    dst.get_pos(), dst.get_angle(), dst.get_type(), true);
+            moved.insert(dst);
+        });
+        if (sel != nullptr) {
+            sel->swap(moved);
+        }
+    }
+    void revert(ssobj_file_shared const& ss, object_set* sel) {
+        sslevels*  currlvl = ss->get_stage(stage);
+        object_set moved(destinations());
+        remove_all(currlvl, moved);
+        insert_all(currlvl, displaced);
+        insert_all(currlvl, source);
+        if (sel != nullptr) {
+            *sel = source;
+        }
+    }
+    MergeResult merge(shift_objects_action const& other) {
+        if (other.stage != stage) {
+            return eNoMerge;
+        }
+
+        std::vector<object> dests = destinations();
+        object_set          targets(dests);
+        if (targets.size() != other.source.size()
+            || !std::equal(
+                    targets.begin(), targets.end(), other.source.begin(),
+                    ObjectMatchFunctor())) {
+            return eNoMerge;
+        }
+
+        // Chain the moves: each object goes where the other action moves
+        // its destination.
+        std::vector<object> const next = other.destinations();
+        for (auto& dst : dests) {
+            auto const pos = other.source.lower_bound(dst);
+            dst            = next[size_t(pos - other.source.begin())];
+        }
+        displaced.unite(other.displaced);
+        if (displaced.empty()
+            && std::equal(
+                    source.begin(), source.end(), dests.cbegin(),
+                    ObjectMatchFunctor())) {
+            return eDeleteAction;
+        }
+        encode(dests);
+        return eMergedActions;
+    }
+    void write(std::ostream& out) const {
+        write_objects(out, source);
+        write_int(out, stage);
+        write_int(out, dseg);
+        write_int(out, drow);
+        write_int(out, dangle);
+        BigEndian::Write4(out, uint32_t(exceptions.size()));
+        for (auto const& elem : exceptions) {
+            BigEndian::Write4(out, elem.first);
+            BigEndian::Write4(out, elem.second);
+        }
+        write_objects(out, displaced);
+    }
+    size_t memory_usage() const noexcept {
+        return sizeof(*this) + source.heap_size()
+               + exceptions.capacity() * sizeof(exceptions.front())
+               + displaced.heap_size();
+    }
 };
 
 class insert_objects_ex_action final : public move_objects_action {
 public:
+    static constexpr const ActionTag tag = ActionTag::eInsertObjectsEx;
+
+    explicit insert_objects_ex_action(std::istream& in)
+            : move_objects_action(in) {}
     insert_objects_ex_action(
             int s, object_set const& del, object_set const& add)
             : move_objects_action(s, del, add) {}
-    MergeResult merge(std::shared_ptr<abstract_action> const& other) override {
+    MergeResult merge(insert_objects_ex_action const& other) {
         ignore_unused_variable_warning(other);
         return eNoMerge;
     }
@@ -243,6 +570,18 @@ class alter_segment_action final : public abstract_action {
     sssegments::SegmentGeometry newgeometry, oldgeometry;
 
 public:
+    static constexpr const ActionTag tag = ActionTag::eAlterSegment;
+
+    explicit alter_segment_action(std::istream& in) {
+        stage         = read_int(in);
+        seg           = read_int(in);
+        newflip       = Read1(in) != 0;
+        oldflip       = Read1(in) != 0;
+        newterminator = sssegments::SegmentTypes(Read1(in));
+        oldterminator = sssegments::SegmentTypes(Read1(in));
+        newgeometry   = sssegments::SegmentGeometry(Read1(in));
+        oldgeometry   = sssegments::SegmentGeometry(Read1(in));
+    }
     alter_segment_action(
             int s, int sg, sssegments const& sgm, bool tf,
             sssegments::SegmentTypes    newterm,
@@ -255,7 +594,7 @@ class alter_segment_action final : public abstract_action {
         newgeometry   = newgeom;
         oldgeometry   = sgm.get_geometry();
     }
-    void apply(ssobj_file_shared ss, object_set* sel) override {
+    void apply(ssobj_file_shared const& ss, object_set* sel) {
         sslevels* currlvl = ss->get_stage(stage);
         if (currlvl == nullptr) {
             return;
@@ -273,7 +612,7 @@ class alter_segment_action final : public abstract_action {
             sel->clear();
         }
     }
-    void revert(ssobj_file_shared ss, object_set* sel) override {
+    void revert(ssobj_file_shared const& ss, object_set* sel) {
         sslevels* currlvl = ss->get_stage(stage);
         if (currlvl == nullptr) {
             return;
@@ -291,27 +630,34 @@ class alter_segment_action final : public abstract_action {
             sel->clear();
         }
     }
-    MergeResult merge(std::shared_ptr<abstract_action> const& other) override {
-        std::shared_ptr<alter_segment_action> act
-                = std::dynamic_pointer_cast<alter_segment_action>(other);
-        if (!act) {
+    MergeResult merge(alter_segment_action const& other) {
+        if (stage != other.stage || seg != other.seg) {
             return eNoMerge;
         }
 
-        if (stage != act->stage || seg != act->seg) {
-            return eNoMerge;
-        }
-
-        if (newflip == act->newflip && newterminator == act->newterminator
-            && newgeometry == act->newgeometry) {
+        if (newflip == other.newflip && newterminator == other.newterminator
+            && newgeometry == other.newgeometry) {
             return eDeleteAction;
         }
 
-        newflip       = act->newflip;
-        newterminator = act->newterminator;
-        newgeometry   = act->newgeometry;
+        newflip       = other.newflip;
+        newterminator = other.newterminator;
+        newgeometry   = other.newgeometry;
         return eMergedActions;
     }
+    void write(std::ostream& out) const {
+        write_int(out, stage);
+        write_int(out, seg);
+        Write1(out, newflip ? 1U : 0U);
+        Write1(out, oldflip ? 1U : 0U);
+        Write1(out, newterminator);
+        Write1(out, oldterminator);
+        Write1(out, newgeometry);
+        Write1(out, oldgeometry);
+    }
+    size_t memory_usage() const noexcept {
+        return sizeof(*this);
+    }
 };
 
 class delete_segment_action : public abstract_action {
@@ -320,9 +666,16 @@ class delete_segment_action : public abstract_action {
     unsigned   stage, seg;
 
 public:
+    static constexpr const ActionTag tag = ActionTag::eDeleteSegment;
+
+    explicit delete_segment_action(std::istream& in) {
+        segment.read(in);
+        stage   = unsigned(read_int(in));
+        seg     = unsigned(read_int(in));
+    }
     delete_segment_action(int s, int sg, sssegments sgm)
             : segment(std::move(sgm)), stage(s), seg(sg) {}
-    void apply(ssobj_file_shared ss, object_set* sel) override {
+    void apply(ssobj_file_shared const& ss, object_set* sel) {
         sslevels* currlvl = ss->get_stage(stage);
         if (seg >= currlvl->num_segments()) {
             return;
@@ -333,7 +686,7 @@ class delete_segment_action : public abstract_action {
             sel->clear();
         }
     }
-    void revert(ssobj_file_shared ss, object_set* sel) override {
+    void revert(ssobj_file_shared const& ss, object_set* sel) {
         sslevels* currlvl = ss->get_stage(stage);
         if (seg == currlvl->num_segments()) {
             ss->get_stage(stage)->append(segment);
@@ -344,22 +697,38 @@ class delete_segment_action : public abstract_action {
             sel->clear();
         }
     }
+    void write(std::ostream& out) const {
+        segment.write(out);
+        write_int(out, int(stage));
+        write_int(out, int(seg));
+    }
+    size_t memory_usage() const noexcept {
+        return sizeof(*this) + segment.heap_size();
+    }
 };
 
 class cut_segment_action final : public delete_segment_action {
 public:
+    static constexpr const ActionTag tag = ActionTag::eCutSegment;
+
+    explicit cut_segment_action(std::istream& in)
+            : delete_segment_action(in) {}
     cut_segment_action(int s, int sg, sssegments const& sgm)
             : delete_segment_action(s, sg, sgm) {}
 };
 
 class insert_segment_action final : public delete_segment_action {
 public:
+    static constexpr const ActionTag tag = ActionTag::eInsertSegment;
+
+    explicit insert_segment_action(std::istream& in)
+            : delete_segment_action(in) {}
     insert_segment_action(int s, int sg, sssegments const& sgm)
             : delete_segment_action(s, sg, sgm) {}
-    void apply(ssobj_file_shared ss, object_set* sel) override {
+    void apply(ssobj_file_shared const& ss, object_set* sel) {
         delete_segment_action::revert(ss, sel);
     }
-    void revert(ssobj_file_shared ss, object_set* sel) override {
+    void revert(ssobj_file_shared const& ss, object_set* sel) {
         delete_segment_action::apply(ss, sel);
     }
 };
@@ -371,8 +740,15 @@ class move_segment_action final : public abstract_action {
     int stage, seg, dir;
 
 public:
+    static constexpr const ActionTag tag = ActionTag::eMoveSegment;
+
+    explicit move_segment_action(std::istream& in) {
+        stage = read_int(in);
+        seg   = read_int(in);
+        dir   = read_int(in);
+    }
     move_segment_action(int s, int sg, int d) : stage(s), seg(sg), dir(d) {}
-    void apply(ssobj_file_shared ss, object_set* sel) override {
+    void apply(ssobj_file_shared const& ss, object_set* sel) {
         if (dir > 0) {
             ss->get_stage(stage)->move_right(seg);
         } else if (dir < 0) {
@@ -382,7 +758,7 @@ class move_segment_action final : public abstract_action {
             sel->clear();
         }
     }
-    void revert(ssobj_file_shared ss, object_set* sel) override {
+    void revert(ssobj_file_shared const& ss, object_set* sel) {
         if (dir < 0) {
             ss->get_stage(stage)->move_right(seg - 1);
         } else if (dir > 0) {
@@ -392,6 +768,14 @@ class move_segment_action final : public abstract_action {
             sel->clear();
         }
     }
+    void write(std::ostream& out) const {
+        write_int(out, stage);
+        write_int(out, seg);
+        write_int(out, dir);
+    }
+    size_t memory_usage() const noexcept {
+        return sizeof(*this);
+    }
 };
 
 class delete_stage_action : public abstract_action {
@@ -400,9 +784,15 @@ class delete_stage_action : public abstract_action {
     unsigned stage;
 
 public:
+    static constexpr const ActionTag tag = ActionTag::eDeleteStage;
+
+    explicit delete_stage_action(std::istream& in) {
+        level.read(in);
+        stage = unsigned(read_int(in));
+    }
     friend class move_stage_action;
     delete_stage_action(int s, sslevels l) : level(std::move(l)), stage(s) {}
-    void apply(ssobj_file_shared ss, object_set* sel) override {
+    void apply(ssobj_file_shared const& ss, object_set* sel) {
         if (stage >= ss->num_stages()) {
             return;
         }
@@ -412,7 +802,7 @@ class delete_stage_action : public abstract_action {
             sel->clear();
         }
     }
-    void revert(ssobj_file_shared ss, object_set* sel) override {
+    void revert(ssobj_file_shared const& ss, object_set* sel) {
         if (stage == ss->num_stages()) {
             ss->append(level);
         } else if (stage < ss->num_stages()) {
@@ -422,17 +812,28 @@ class delete_stage_action : public abstract_action {
             sel->clear();
         }
     }
+    void write(std::ostream& out) const {
+        level.write(out);
+        write_int(out, int(stage));
+    }
+    size_t memory_usage() const noexcept {
+        return sizeof(*this) + level.heap_size();
+    }
 };
 
 using cut_stage_action = delete_stage_action;
 
 class insert_stage_action final : public delete_stage_action {
 public:
+    static constexpr const ActionTag tag = ActionTag::eInsertStage;
+
+    explicit insert_stage_action(std::istream& in)
+            : delete_stage_action(in) {}
     insert_stage_action(int s, sslevels const& l) : delete_stage_action(s, l) {}
-    void apply(ssobj_file_shared ss, object_set* sel) override {
+    void apply(ssobj_file_shared const& ss, object_set* sel) {
         delete_stage_action::revert(ss, sel);
     }
-    void revert(ssobj_file_shared ss, object_set* sel) override {
+    void revert(ssobj_file_shared const& ss, object_set* sel) {
         delete_stage_action::apply(ss, sel);
     }
 };
@@ -444,8 +845,14 @@ class move_stage_action final : public abstract_action {
     int stage, dir;
 
 public:
+    static constexpr const ActionTag tag = ActionTag::eMoveStage;
+
+    explicit move_stage_action(std::istream& in) {
+        stage = read_int(in);
+        dir   = read_int(in);
+    }
     move_stage_action(int s, int d) : stage(s), dir(d) {}
-    void apply(ssobj_file_shared ss, object_set* sel) override {
+    void apply(ssobj_file_shared const& ss, object_set* sel) {
         if (dir > 0) {
             ss->move_right(stage);
         } else if (dir < 0) {
@@ -455,7 +862,7 @@ class move_stage_action final : public abstract_action {
             sel->clear();
         }
     }
-    void revert(ssobj_file_shared ss, object_set* sel) override {
+    void revert(ssobj_file_shared const& ss, object_set* sel) {
         if (dir < 0) {
             ss->move_right(stage - 1);
         } else if (dir > 0) {
@@ -465,6 +872,150 @@ class move_stage_action final : public abstract_action {
             sel->clear();
         }
     }
+    void write(std::ostream& out) const {
+        write_int(out, stage);
+        write_int(out, dir);
+    }
+    size_t memory_usage() const noexcept {
+        return sizeof(*this);
+    }
 };
 
+template <typename Act>
+struct action_type {
+    using type = Act;
+};
+
+// Calls func with an action_type for the given tag.
+template <typename Func>
+void visit_action_type(ActionTag tag, Func&& func) {
+    switch (tag) {
+    case ActionTag::eAlterSelection:
+        func(action_type<alter_selection_action>{});
+        return;
+    case ActionTag::eDeleteSelection:
+        func(action_type<delete_selection_action>{});
+        return;
+    case ActionTag::eInsertObjects:
+        func(action_type<insert_objects_action>{});
+        return;
+    case ActionTag::eMoveObjects:
+        func(action_type<move_objects_action>{});
+        return;
+    case ActionTag::eShiftObjects:
+        func(action_type<shift_objects_action>{});
+        return;
+    case ActionTag::eInsertObjectsEx:
+        func(action_type<insert_objects_ex_action>{});
+        return;
+    case ActionTag::eAlterSegment:
+        func(action_type<alter_segment_action>{});
+        return;
+    case ActionTag::eDeleteSegment:
+        func(action_type<delete_segment_action>{});
+        return;
+    case ActionTag::eCutSegment:
+        func(action_type<cut_segment_action>{});
+        return;
+    case ActionTag::eInsertSegment:
+        func(action_type<insert_segment_action>{});
+        return;
+    case ActionTag::eMoveSegment:
+        func(action_type<move_segment_action>{});
+        return;
+    case ActionTag::eDeleteStage:
+        func(action_type<delete_stage_action>{});
+        return;
+    case ActionTag::eInsertStage:
+        func(action_type<insert_stage_action>{});
+        return;
+    case ActionTag::eMoveStage:
+        func(action_type<move_stage_action>{});
+        return;
+    }
+}
+
+inline bool is_action_tag(unsigned value) noexcept {
+    return value <= unsigned(ActionTag::eMoveStage);
+}
+
+// Calls func with the action of the given tag stored at act.
+template <typename Func>
+void visit_action(ActionTag tag, void* act, Func&& func) {
+    visit_action_type(tag, [act, &func](auto type) {
+        using Act = typename decltype(type)::type;
+        func(*static_cast<Act*>(act));
+    });
+}
+
+// Applies or reverts the action stored at act.
+inline void apply_action(
+        ActionTag tag, void* act, ssobj_file_shared const& ss,
+        object_set* sel) {
+    visit_action(tag, act, [&](auto& action) { action.apply(ss, sel); });
+}
+
+inline void revert_action(
+        ActionTag tag, void* act, ssobj_file_shared const& ss,
+        object_set* sel) {
+    visit_action(tag, act, [&](auto& action) { action.revert(ss, sel); });
+}
+
+inline size_t action_memory_usage(ActionTag tag, void* act) noexcept {
+    size_t size = 0;
+    visit_action(
+            tag, act, [&size](auto& action) { size = action.memory_usage(); });
+    return size;
+}
+
+// Merges the newer action next into act; actions of different types never
+// merge.
+inline abstract_action::MergeResult merge_actions(
+        ActionTag tag, void* act, ActionTag nexttag, void const* next) {
+    abstract_action::MergeResult result = abstract_action::eNoMerge;
+    if (tag != nexttag) {
+        return result;
+    }
+    visit_action(tag, act, [&result, next](auto& action) {
+        using Act = std::decay_t<decltype(action)>;
+        result    = action.merge(*static_cast<Act const*>(next));
+    });
+    return result;
+}
+
+// Saves the action stored at act, for replay_action.
+inline void write_action(ActionTag tag, void* act, std::ostream& out) {
+    visit_action(tag, act, [&out](auto& action) { action.write(out); });
+}
+
+// Reads back an action saved by write_action and applies or reverts it.
+// Returns false if the action could not be read.
+inline bool replay_action(
+        ActionTag tag, std::istream& in, ssobj_file_shared const& ss,
+        bool revert) {
+    bool done = false;
+    visit_action_type(tag, [&](auto type) {
+        using Act = typename decltype(type)::type;
+        Act action(in);
+        if (in.fail()) {
+            return;
+        }
+        if (revert) {
+            action.revert(ss, nullptr);
+        } else {
+            action.apply(ss, nullptr);
+        }
+        done = true;
+    });
+    return done;
+}
+
+// Destroys the action stored at act.
+inline void destroy_action(ActionTag tag, void* act) noexcept {
+    visit_action(tag, act, [](auto& action) {
+        using Act = std::decay_t<decltype(action)>;
+        action.~Act();
+    });
+}
+
 #endif    // ABSTRACTACTION_H
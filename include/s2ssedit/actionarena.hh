@@ -0,0 +1,126 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) Flamewing 2011-2019 <flamewing.sonic@gmail.com>
+ *
+ * S2-SSEdit is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * S2-SSEdit is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ACTIONARENA_H
+#define ACTIONARENA_H
+
+#include "s2ssedit/abstractaction.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <new>
+#include <utility>
+
+// Storage for the actions of the undo history. Actions are constructed in
+// place in large blocks, each after a small header with its tag, so adding
+// one does not allocate unless a block fills up. Actions are only ever
+// added at the end and removed from either end, and blocks are released
+// as soon as they empty.
+class action_arena {
+public:
+    struct record {
+        ActionTag tag;
+        uint32_t  size;    // Bytes taken in the block, header included.
+
+        void* get() noexcept {
+            return reinterpret_cast<unsigned char*>(this) + header_size;
+        }
+        void const* get() const noexcept {
+            return reinterpret_cast<unsigned char const*>(this) + header_size;
+        }
+    };
+
+    static constexpr const size_t alignment = alignof(std::max_align_t);
+    static constexpr const size_t header_size
+            = (sizeof(record) + alignment - 1) / alignment * alignment;
+    static constexpr const size_t block_size = 64 * 1024;
+
+private:
+    struct block {
+        std::unique_ptr<unsigned char[]> data;
+        size_t                           capacity;
+        size_t                           first, last;
+    };
+
+    std::deque<block>   blocks;
+    std::deque<record*> records;    // Oldest first.
+    // Last emptied block, kept to avoid allocating again when records are
+    // repeatedly added and removed around a block boundary.
+    block  spare{nullptr, 0, 0, 0};
+    size_t reserved = 0;
+
+    static constexpr size_t round_up(size_t size) noexcept {
+        return (size + alignment - 1) / alignment * alignment;
+    }
+    unsigned char* allocate(size_t size);
+    void           release(block& blk) noexcept;
+    void           drop_empty_block() noexcept;
+
+public:
+    action_arena() noexcept = default;
+    action_arena(action_arena const&) = delete;
+    action_arena(action_arena&&)      = delete;
+    action_arena& operator=(action_arena const&) = delete;
+    action_arena& operator=(action_arena&&) = delete;
+    ~action_arena() noexcept {
+        clear();
+    }
+
+    template <typename Act, typename... Args>
+    record& emplace_back(Args&&... args) {
+        size_t const   size = header_size + round_up(sizeof(Act));
+        unsigned char* ptr  = allocate(size);
+        try {
+            new (ptr + header_size) Act(std::forward<Args>(args)...);
+        } catch (...) {
+            drop_empty_block();
+            throw;
+        }
+        auto* rec = new (ptr) record{Act::tag, uint32_t(size)};
+        blocks.back().last += size;
+        records.push_back(rec);
+        return *rec;
+    }
+    void pop_back() noexcept;
+    void pop_front() noexcept;
+    void clear() noexcept;
+
+    size_t size() const noexcept {
+        return records.size();
+    }
+    bool empty() const noexcept {
+        return records.empty();
+    }
+    record& operator[](size_t index) noexcept {
+        return *records[index];
+    }
+    record const& operator[](size_t index) const noexcept {
+        return *records[index];
+    }
+    record& back() noexcept {
+        return *records.back();
+    }
+    // Bytes held in blocks, used or not.
+    size_t capacity() const noexcept {
+        return reserved;
+    }
+};
+
+#endif    // ACTIONARENA_H
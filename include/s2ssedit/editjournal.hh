@@ -0,0 +1,94 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) Flamewing 2011-2019 <flamewing.sonic@gmail.com>
+ *
+ * S2-SSEdit is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * S2-SSEdit is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EDITJOURNAL_H
+#define EDITJOURNAL_H
+
+#include "s2ssedit/abstractaction.hh"
+#include "s2ssedit/actionarena.hh"
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#define SS_JOURNAL_FILE "s2ssedit.journal"
+
+// Append-only log of the edits made since the project was last saved,
+// kept next to the project files so the edits can be recovered after a
+// crash. Each record is an action and whether it was applied or reverted;
+// replaying the records in order onto the saved project redoes the edits.
+// Records are buffered and written in batches; sync() also flushes them to
+// disk, and a record cut short by a crash is ignored. The journal closes at
+// the first write error, keeping what was written before it.
+class edit_journal {
+public:
+    enum Operation : uint8_t { eApply = 0, eRevert = 1 };
+
+    // Buffered bytes that trigger a write.
+    static constexpr const size_t batch_size = 16 * 1024;
+
+private:
+    std::string path;
+    std::FILE*  file = nullptr;
+    std::string pending;
+    size_t      records  = 0;
+    bool        unsynced = false;
+    bool        failed   = false;
+
+    void fail() noexcept;
+
+public:
+    edit_journal() noexcept = default;
+    edit_journal(edit_journal const&) = delete;
+    edit_journal(edit_journal&&)      = delete;
+    edit_journal& operator=(edit_journal const&) = delete;
+    edit_journal& operator=(edit_journal&&) = delete;
+    ~edit_journal() noexcept {
+        close();
+    }
+
+    // Starts the journal of the project in dir, as saved. Unless keep is
+    // set, any journal already there is replaced.
+    bool open(std::string const& dir, bool keep = false);
+    // Writes out what is left, and removes the journal if it holds no
+    // edits.
+    void close() noexcept;
+    bool is_open() const noexcept {
+        return file != nullptr;
+    }
+
+    void append(Operation op, action_arena::record& rec);
+    void flush() noexcept;
+    void sync() noexcept;
+    // Returns true, once, if the journal could not be opened or written
+    // since the last call.
+    bool take_error() noexcept {
+        bool const result = failed;
+        failed            = false;
+        return result;
+    }
+
+    // Number of edits in a journal left in dir, if it was made for the
+    // project as currently saved; zero otherwise.
+    static size_t pending_edits(std::string const& dir);
+    // Replays the journal left in dir onto ss, which must hold the project
+    // as saved. Returns the number of edits replayed.
+    static size_t replay(std::string const& dir, ssobj_file_shared const& ss);
+};
+
+#endif    // EDITJOURNAL_H
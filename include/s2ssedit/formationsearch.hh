@@ -0,0 +1,60 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) Flamewing 2011-2019 <flamewing.sonic@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FORMATIONSEARCH_H
+#define FORMATIONSEARCH_H
+
+#include "s2ssedit/objectset.hh"
+#include "s2ssedit/patternlibrary.hh"
+#include "s2ssedit/ssobjfile.hh"
+
+#include <cstdint>
+#include <vector>
+
+// A place where a formation was found: the stage row and angle that its
+// first cell fell on, and the objects it matched.
+struct formation_match {
+    unsigned   stage;
+    int        row;
+    uint8_t    angle;
+    object_set objects;
+};
+
+// Finds a formation, such as one captured from the selection, anywhere in
+// a stage, moved by any number of rows and angles. Each stage is laid out
+// as a grid of (row, angle) cells, and the formation is tried with its
+// first cell on each object that could be it; all other cells are then
+// direct lookups. Cells that don't name a type match either type. Objects
+// past the end of their segment are not drawn, and are never matched.
+class formation_search {
+public:
+    // Matches in stage order; each object is in one match at most, so the
+    // matches can all be replaced at once.
+    static std::vector<formation_match> find(
+            insert_pattern const& pat, sslevels const& stage,
+            unsigned index);
+    static std::vector<formation_match> find(
+            insert_pattern const& pat, ssobj_file const& file);
+    // Objects of pat with its first cell on the given row and angle of the
+    // stage; cells that fall outside the stage are left out.
+    static object_set place(
+            insert_pattern const& pat, sslevels const& stage, int row,
+            uint8_t angle, sssegments::ObjectTypes deftype);
+};
+
+#endif    // FORMATIONSEARCH_H
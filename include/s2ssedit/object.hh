@@ -21,51 +21,69 @@
 
 #include "s2ssedit/ssobjfile.hh"
 
+// An object position and type, packed into a single 32-bit key. From most to
+// least significant bits: segment (15 bits), row (8 bits), angle (8 bits)
+// and type (1 bit). Ordering keys ignoring the type bit therefore orders
+// objects by segment, then row, then angle.
 class object {
 private:
-    int32_t segment = -1;
-    int32_t pos     = 0;
-    int32_t angle   = 0;
+    static constexpr const uint32_t type_bits     = 1U;
+    static constexpr const uint32_t angle_shift   = type_bits;
+    static constexpr const uint32_t row_shift     = angle_shift + 8U;
+    static constexpr const uint32_t segment_shift = row_shift + 8U;
+    static constexpr const uint32_t byte_mask     = 0xffU;
+    static constexpr const uint32_t type_mask     = (1U << type_bits) - 1U;
+    static constexpr const uint32_t segment_mask  = 0x7fffU;
 
-    sssegments::ObjectTypes type = sssegments::eRing;
+    uint32_t key = segment_mask << segment_shift;
+
+    static constexpr uint32_t pack(
+            int seg, unsigned x, unsigned y,
+            sssegments::ObjectTypes t) noexcept {
+        return ((static_cast<uint32_t>(seg) & segment_mask) << segment_shift)
+               | ((y & byte_mask) << row_shift)
+               | ((x & byte_mask) << angle_shift)
+               | (t == sssegments::eBomb ? 1U : 0U);
+    }
 
 public:
     object(int seg, unsigned x, unsigned y, sssegments::ObjectTypes t)
-            : segment(seg), pos(y), angle(x), type(t) {}
+            : key(pack(seg, x, y, t)) {}
     object() noexcept = default;
+    static object from_key(uint32_t k) noexcept {
+        object obj;
+        obj.key = k;
+        return obj;
+    }
+
+    uint32_t get_key() const noexcept {
+        return key;
+    }
+    // Key without the type; equal for objects in the same spot.
+    uint32_t get_position_key() const noexcept {
+        return key >> type_bits;
+    }
     sssegments::ObjectTypes get_type() const {
-        return type;
+        return (key & type_mask) != 0 ? sssegments::eBomb : sssegments::eRing;
     }
 
     int32_t get_segment() const {
-        return segment;
+        return valid() ? static_cast<int32_t>(key >> segment_shift) : -1;
     }
     int32_t get_pos() const {
-        return pos;
+        return static_cast<int32_t>((key >> row_shift) & byte_mask);
     }
     int32_t get_angle() const {
-        return angle;
+        return static_cast<int32_t>((key >> angle_shift) & byte_mask);
     }
     bool valid() const {
-        return segment != -1;
+        return (key >> segment_shift) != segment_mask;
     }
     bool operator<(object const& other) const {
-        if (segment < other.segment) {
-            return true;
-        }
-        if (segment > other.segment) {
-            return false;
-        }
-        if (pos < other.pos) {
-            return true;
-        }
-        if (pos > other.pos) {
-            return false;
-        }
-        return angle < other.angle;
+        return get_position_key() < other.get_position_key();
     }
     bool operator==(object const& other) const {
-        return !(*this < other) && !(other < *this);
+        return get_position_key() == other.get_position_key();
     }
     bool operator!=(object const& other) const {
         return !(*this == other);
@@ -80,34 +98,28 @@ class object {
         return !(*this < other);
     }
     void reset() {
-        segment = -1;
-        angle   = 0;
-        pos     = 0;
-        type    = sssegments::eRing;
+        key = segment_mask << segment_shift;
     }
     void set_segment(int seg) {
-        segment = seg;
+        set(seg, get_angle(), get_pos(), get_type());
     }
     void set_pos(unsigned y) {
-        pos = y;
+        set(get_segment(), get_angle(), y, get_type());
     }
     void set_angle(unsigned x) {
-        angle = x;
+        set(get_segment(), x, get_pos(), get_type());
     }
     void set_type(sssegments::ObjectTypes t) {
-        type = t;
+        set(get_segment(), get_angle(), get_pos(), t);
     }
     void set(int seg, unsigned x, unsigned y, sssegments::ObjectTypes t) {
-        segment = seg;
-        angle   = x;
-        pos     = y;
-        type    = t;
+        key = pack(seg, x, y, t);
     }
 };
 
 struct ObjectMatchFunctor {
     bool operator()(object const& obj1, object const& obj2) const {
-        return obj1 == obj2 && obj1.get_type() == obj2.get_type();
+        return obj1.get_key() == obj2.get_key();
     }
 };
 
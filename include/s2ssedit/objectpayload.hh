@@ -0,0 +1,82 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) Flamewing 2011-2019 <flamewing.sonic@gmail.com>
+ *
+ * S2-SSEdit is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * S2-SSEdit is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OBJECTPAYLOAD_H
+#define OBJECTPAYLOAD_H
+
+#include "s2ssedit/objectset.hh"
+#include "s2ssedit/sslevelobjs.hh"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define SS_OBJECTS_TARGET "application/x-s2ssedit-objects"
+#define SS_ROWS_TARGET    "application/x-s2ssedit-rows"
+#define SS_SEGMENT_TARGET "application/x-s2ssedit-segment"
+#define SS_STAGE_TARGET   "application/x-s2ssedit-stage"
+
+// Binary forms of objects, segments and stages, used for drag and drop and
+// for the clipboard. Each is a 12 byte header (the magic "S2SD", a version
+// byte, a kind byte, two zero bytes and a count) followed by the contents:
+//   - objects: the packed key of each object, in set order;
+//   - rows: objects as rows relative to a point of the stage, so they can
+//     be pasted into any stage; each is a 32-bit row << 9 | angle << 1 |
+//     bomb;
+//   - segment, stage: the segments as the edit journal stores them; the
+//     count is the number of segments.
+// Numbers in the header and records are little endian, so on most hosts
+// object keys are copied in and out with a single memcpy. Segments and
+// stages are decoded as a stream straight from the payload.
+class object_payload {
+public:
+    enum Kinds : uint8_t {
+        eObjects = 0,
+        eObjectRows,
+        eSegment,
+        eStage,
+        eNumKinds
+    };
+    // An object by its stage row, relative to some reference row.
+    struct object_row {
+        int32_t                 row;
+        uint8_t                 angle;
+        sssegments::ObjectTypes type;
+    };
+
+    static constexpr const uint8_t version     = 1;
+    static constexpr const size_t  header_size = 12;
+    static constexpr const size_t  record_size = 4;
+
+    static char const* target(Kinds kind) noexcept;
+
+    static std::string encode(object_set const& objs);
+    static std::string encode(std::vector<object_row> const& rows);
+    static std::string encode(sssegments const& sgm);
+    static std::string encode(sslevels const& lvl);
+    // Each replaces its output with the contents of the payload. They return
+    // false, leaving the output alone, if the data is not a payload of the
+    // right kind and version.
+    static bool decode(void const* data, size_t len, object_set& objs);
+    static bool decode(
+            void const* data, size_t len, std::vector<object_row>& rows);
+    static bool decode(void const* data, size_t len, sssegments& sgm);
+    static bool decode(void const* data, size_t len, sslevels& lvl);
+};
+
+#endif    // OBJECTPAYLOAD_H
@@ -0,0 +1,66 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) Flamewing 2011-2019 <flamewing.sonic@gmail.com>
+ *
+ * S2-SSEdit is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * S2-SSEdit is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OBJECTQUERY_H
+#define OBJECTQUERY_H
+
+#include "s2ssedit/objectset.hh"
+#include "s2ssedit/sslevelobjs.hh"
+
+#include <cstdint>
+#include <limits>
+
+// Filter over the objects of a stage, used to select objects by their
+// properties instead of by position. All ranges are inclusive.
+class object_query {
+public:
+    enum TypeFilter { eAnyType = 0, eRingsOnly, eBombsOnly };
+    enum HeightFilter { eAnyHeight = 0, eAerialOnly, eGroundOnly };
+    enum SegmentTypeMask : uint8_t {
+        eNormalMask       = 1U << 0U,
+        eRingsMessageMask = 1U << 1U,
+        eCheckpointMask   = 1U << 2U,
+        eChaosEmeraldMask = 1U << 3U,
+        eAnySegmentType   = 0x0fU
+    };
+
+    TypeFilter   type          = eAnyType;
+    HeightFilter height        = eAnyHeight;
+    uint8_t      segment_types = eAnySegmentType;
+    size_t       first_segment = 0;
+    size_t       last_segment  = std::numeric_limits<size_t>::max();
+    uint8_t      first_row     = 0;
+    uint8_t      last_row      = sssegments::ePositionMask;
+    // The angle band wraps around if first_angle > last_angle.
+    uint8_t first_angle = 0x00;
+    uint8_t last_angle  = 0xff;
+
+    static SegmentTypeMask type_mask(sssegments::SegmentTypes t) noexcept;
+
+    bool matches(sssegments const& seg) const noexcept {
+        return (segment_types & type_mask(seg.get_type())) != 0;
+    }
+    bool matches(uint8_t angle, sssegments::ObjectTypes t) const noexcept;
+
+    // Finds all matching objects of the stage in a single pass over the
+    // segments in range. Objects are visited in order, so the result set is
+    // built by appending.
+    object_set run(sslevels const& stage) const;
+};
+
+#endif    // OBJECTQUERY_H
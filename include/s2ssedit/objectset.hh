@@ -0,0 +1,193 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) Flamewing 2011-2019 <flamewing.sonic@gmail.com>
+ *
+ * S2-SSEdit is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * S2-SSEdit is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OBJECTSET_H
+#define OBJECTSET_H
+
+#include "s2ssedit/object.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+// Set of objects, unique by position, stored as a sorted vector of packed
+// keys. Mirrors the parts of the std::set interface used by the editor; as
+// with std::set, elements can't be modified in place.
+// Every modification takes a new, globally unique revision, so that derived
+// data (such as selection bitmaps) can be cached by revision; copies share
+// the revision because they share the contents.
+class object_set {
+private:
+    std::vector<object> objects;
+    uint64_t            revision = 0;
+
+    static uint64_t next_revision() noexcept {
+        static std::atomic<uint64_t> counter(0);
+        return ++counter;
+    }
+    void touch() noexcept {
+        revision = next_revision();
+    }
+    template <typename Merge>
+    void merge(object_set const& other, Merge merge_op) {
+        std::vector<object> result;
+        result.reserve(objects.size() + other.objects.size());
+        merge_op(
+                objects.cbegin(), objects.cend(), other.objects.cbegin(),
+                other.objects.cend(), std::back_inserter(result));
+        objects.swap(result);
+        touch();
+    }
+
+public:
+    using value_type     = object;
+    using size_type      = size_t;
+    using const_iterator = std::vector<object>::const_iterator;
+    using iterator       = const_iterator;
+
+    object_set() noexcept = default;
+    // Takes objects in any order; duplicate positions keep the first one.
+    explicit object_set(std::vector<object> objs)
+            : objects(std::move(objs)), revision(next_revision()) {
+        std::stable_sort(objects.begin(), objects.end());
+        objects.erase(
+                std::unique(objects.begin(), objects.end()), objects.end());
+    }
+    object_set(std::initializer_list<object> objs)
+            : object_set(std::vector<object>(objs)) {}
+    object_set(object_set const& other) = default;
+    object_set& operator=(object_set const& other) = default;
+    // A moved-from set is left empty, with the revision of an empty set.
+    object_set(object_set&& other) noexcept
+            : objects(std::move(other.objects)), revision(other.revision) {
+        other.objects.clear();
+        other.revision = 0;
+    }
+    object_set& operator=(object_set&& other) noexcept {
+        object_set temp(std::move(other));
+        swap(temp);
+        return *this;
+    }
+    ~object_set() noexcept = default;
+
+    const_iterator begin() const noexcept {
+        return objects.cbegin();
+    }
+    const_iterator end() const noexcept {
+        return objects.cend();
+    }
+    size_t size() const noexcept {
+        return objects.size();
+    }
+    bool empty() const noexcept {
+        return objects.empty();
+    }
+    // Heap memory used by the set.
+    size_t heap_size() const noexcept {
+        return objects.capacity() * sizeof(object);
+    }
+    uint64_t get_revision() const noexcept {
+        return revision;
+    }
+    void clear() noexcept {
+        if (!objects.empty()) {
+            objects.clear();
+            touch();
+        }
+    }
+    void reserve(size_t count) {
+        objects.reserve(count);
+    }
+    void swap(object_set& other) noexcept {
+        objects.swap(other.objects);
+        std::swap(revision, other.revision);
+    }
+
+    const_iterator lower_bound(object const& obj) const {
+        return std::lower_bound(objects.cbegin(), objects.cend(), obj);
+    }
+    const_iterator find(object const& obj) const {
+        auto it = lower_bound(obj);
+        if (it != objects.cend() && *it == obj) {
+            return it;
+        }
+        return objects.cend();
+    }
+    size_t count(object const& obj) const {
+        return find(obj) == objects.cend() ? 0U : 1U;
+    }
+
+    std::pair<iterator, bool> insert(object const& obj) {
+        // Objects are very often added in order; make that case cheap.
+        if (objects.empty() || objects.back() < obj) {
+            objects.push_back(obj);
+            touch();
+            return {std::prev(objects.cend()), true};
+        }
+        auto it = lower_bound(obj);
+        if (*it == obj) {
+            return {it, false};
+        }
+        touch();
+        return {objects.insert(it, obj), true};
+    }
+    template <typename... Args>
+    std::pair<iterator, bool> emplace(Args&&... args) {
+        return insert(object(std::forward<Args>(args)...));
+    }
+
+    iterator erase(const_iterator it) {
+        touch();
+        return objects.erase(it);
+    }
+    size_t erase(object const& obj) {
+        auto it = find(obj);
+        if (it == objects.cend()) {
+            return 0U;
+        }
+        objects.erase(it);
+        touch();
+        return 1U;
+    }
+
+    // Set operations, each a single linear merge. Where both sets have an
+    // object in the same spot, the one in this set is kept.
+    // Adds the objects not in the set, and removes those that are.
+    void toggle(object_set const& other) {
+        merge(other, [](auto... args) {
+            return std::set_symmetric_difference(args...);
+        });
+    }
+    void unite(object_set const& other) {
+        merge(other, [](auto... args) { return std::set_union(args...); });
+    }
+    void subtract(object_set const& other) {
+        merge(other,
+              [](auto... args) { return std::set_difference(args...); });
+    }
+    void intersect(object_set const& other) {
+        merge(other,
+              [](auto... args) { return std::set_intersection(args...); });
+    }
+};
+
+#endif    // OBJECTSET_H
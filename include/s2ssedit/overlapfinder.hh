@@ -0,0 +1,75 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) Flamewing 2011-2019 <flamewing.sonic@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OVERLAPFINDER_H
+#define OVERLAPFINDER_H
+
+#include "s2ssedit/object.hh"
+#include "s2ssedit/objectset.hh"
+#include "s2ssedit/ssobjfile.hh"
+
+#include <vector>
+
+// Two objects of a stage drawn on top of each other, or nearly so; first
+// comes before second in the stage.
+struct object_overlap {
+    unsigned stage;
+    object   first, second;
+};
+
+// Finds objects closer to each other than a sprite. Objects are hashed into
+// cells as wide as the gaps, so each object is only compared with the ones
+// in the cells around it, and a whole file is checked in time proportional
+// to the number of objects. Objects beyond the end of their segment are not
+// drawn, and are left to the validator.
+class overlap_finder {
+public:
+    // A sprite is IMAGE_SIZE pixels, which is 8 angles and 1 row.
+    static constexpr const unsigned default_angle_gap = 8;
+    static constexpr const unsigned default_row_gap   = 1;
+    static constexpr const unsigned max_angle_gap     = 128;
+
+private:
+    unsigned angle_gap;
+    unsigned row_gap;
+
+public:
+    // Objects overlap if they are less than both gaps apart; angles wrap
+    // around. Gaps are clamped to 1 to max_angle_gap angles and at least
+    // 1 row.
+    explicit overlap_finder(
+            unsigned angles = default_angle_gap,
+            unsigned rows   = default_row_gap) noexcept;
+
+    unsigned get_angle_gap() const noexcept {
+        return angle_gap;
+    }
+    unsigned get_row_gap() const noexcept {
+        return row_gap;
+    }
+
+    // Overlaps in stage order, each pair once.
+    std::vector<object_overlap> find(
+            sslevels const& stage, unsigned index) const;
+    std::vector<object_overlap> find(ssobj_file const& file) const;
+    // Objects that can go so that no overlaps are left: going through the
+    // stage in order, each object that overlaps one that stays.
+    object_set redundant(sslevels const& stage) const;
+};
+
+#endif    // OVERLAPFINDER_H
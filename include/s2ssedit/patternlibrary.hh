@@ -0,0 +1,107 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) Flamewing 2011-2019 <flamewing.sonic@gmail.com>
+ *
+ * S2-SSEdit is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * S2-SSEdit is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PATTERNLIBRARY_H
+#define PATTERNLIBRARY_H
+
+#include "s2ssedit/objectset.hh"
+#include "s2ssedit/sssegmentobjs.hh"
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#define SS_PATTERN_FILE "patterns.txt"
+
+// A formation of objects, compiled to a table of offsets from the point
+// where it is placed. Angles are in object units and wrap around the tube.
+struct insert_pattern {
+    // Cells take the type being inserted unless they name one.
+    static constexpr const uint8_t current_type = 0xffU;
+    struct cell {
+        int16_t row;
+        uint8_t angle;
+        uint8_t type;
+    };
+
+    std::string       name;
+    std::vector<cell> cells;
+    // Definition the pattern was compiled from, as it would be written out.
+    std::string definition;
+
+    sssegments::ObjectTypes get_type(
+            cell const& c, sssegments::ObjectTypes deftype) const noexcept {
+        return c.type == current_type
+                       ? deftype
+                       : static_cast<sssegments::ObjectTypes>(c.type);
+    }
+};
+
+// Formations available for insertion, read from text files with one
+// definition per line:
+//
+//     line   "name" count=8 spacing=1 step=0
+//     arc    "name" count=9 radius=4 width=32 span=180
+//     spiral "name" count=16 spacing=2 turns=1
+//     wave   "name" count=24 spacing=1 amplitude=16 period=8
+//     stamp  "name" row:angle:type ...
+//
+// Parameters may be left out, or given in any order; type is r or b. Blank
+// lines and lines starting with # are ignored. Each definition is compiled
+// once, when it is read.
+class pattern_library {
+private:
+    std::vector<insert_pattern> patterns;
+
+public:
+    // Adds the patterns defined in the stream. Malformed definitions are
+    // skipped, with a message naming source and line added to errors.
+    void load(
+            std::istream& in, std::string const& source,
+            std::vector<std::string>& errors);
+    // As above, from a file; a missing file is not an error.
+    void load_file(std::string const& path, std::vector<std::string>& errors);
+    // Compiles one definition; returns false, and sets error, if it is not
+    // valid.
+    static bool compile(
+            std::string const& definition, insert_pattern& pat,
+            std::string& error);
+    // Makes a stamp of objs, anchored at the first of them; segpos gives the
+    // stage row where each segment starts.
+    static insert_pattern capture(
+            std::string const& name, object_set const& objs,
+            std::vector<int> const& segpos);
+    // Appends the definition of pat to the file at path.
+    static bool save(std::string const& path, insert_pattern const& pat);
+
+    void add(insert_pattern pat) {
+        patterns.push_back(std::move(pat));
+    }
+    size_t size() const noexcept {
+        return patterns.size();
+    }
+    bool empty() const noexcept {
+        return patterns.empty();
+    }
+    insert_pattern const& operator[](size_t index) const {
+        return patterns[index];
+    }
+};
+
+#endif    // PATTERNLIBRARY_H
@@ -0,0 +1,104 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) Flamewing 2011-2019 <flamewing.sonic@gmail.com>
+ *
+ * S2-SSEdit is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * S2-SSEdit is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RENDERPROFILE_H
+#define RENDERPROFILE_H
+
+#include <cairomm/context.h>
+
+#include <array>
+#include <chrono>
+#include <deque>
+#include <ostream>
+#include <vector>
+
+// Collects per-phase timings of each repaint of the editor canvas. Phases
+// nest: time spent in an inner phase is not charged to the outer one.
+class render_profile {
+public:
+    enum Phases {
+        eBackground = 0,
+        eBeams,
+        eBalls,
+        eObjects,
+        eOverlays,
+        eNumPhases
+    };
+
+    struct frame {
+        std::array<double, eNumPhases> times{};    // In milliseconds.
+        double                         total   = 0.0;
+        size_t                         objects = 0;
+    };
+
+    // Charges the time between its construction and destruction to a phase.
+    // Does nothing if given a null profile.
+    class scope {
+    private:
+        render_profile* profile;
+
+    public:
+        scope(render_profile* prof, Phases phase) : profile(prof) {
+            if (profile != nullptr) {
+                profile->begin(phase);
+            }
+        }
+        ~scope() {
+            if (profile != nullptr) {
+                profile->end();
+            }
+        }
+        scope(scope const&) = delete;
+        scope& operator=(scope const&) = delete;
+    };
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    // Frames kept for the overlay; the CSV dump keeps everything.
+    static constexpr const size_t max_recent = 240;
+
+    std::deque<frame>   recent;
+    std::vector<frame>  history;
+    frame               current;
+    std::vector<Phases> stack;
+    clock::time_point   frame_start, mark;
+
+    double elapsed_since_mark();
+    void   begin(Phases phase);
+    void   end();
+
+public:
+    void begin_frame();
+    void end_frame();
+    void add_objects(size_t count) noexcept {
+        current.objects += count;
+    }
+    void clear();
+
+    size_t num_frames() const noexcept {
+        return history.size();
+    }
+    void write_csv(std::ostream& out) const;
+    // Draws the averages and a histogram of recent frame times with its top
+    // left corner at (x, y).
+    void draw(Cairo::RefPtr<Cairo::Context> const& cr, double x, double y)
+            const;
+};
+
+#endif    // RENDERPROFILE_H
@@ -0,0 +1,68 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) Flamewing 2011-2019 <flamewing.sonic@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SEGMENTINDEX_H
+#define SEGMENTINDEX_H
+
+#include "s2ssedit/ssobjfile.hh"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Segments of a project grouped by content: objects, geometry, flip and
+// type. The object file has no way to share segments, so each copy is
+// stored again. The hash of each segment is cached by segment revision, so
+// an update only hashes the segments changed since the last one.
+class segment_index {
+public:
+    struct location {
+        unsigned stage;
+        unsigned segment;
+    };
+    // Identical segments, in project order, and the bytes each copy takes
+    // in the object file.
+    struct duplicate_group {
+        std::vector<location> copies;
+        size_t                size = 0;
+
+        size_t wasted() const noexcept {
+            return size * (copies.size() - 1);
+        }
+    };
+
+private:
+    std::unordered_map<uint64_t, uint64_t> hashes;
+    std::vector<duplicate_group>           duplicates;
+
+public:
+    // Hash of the bytes the segment is written as.
+    static uint64_t content_hash(sssegments const& seg) noexcept;
+    // Whether both segments are written as the same bytes.
+    static bool same_content(
+            sssegments const& lhs, sssegments const& rhs) noexcept;
+
+    void update(ssobj_file const& file);
+    // Groups of two or more identical segments, the most wasteful first.
+    std::vector<duplicate_group> const& get_duplicates() const noexcept {
+        return duplicates;
+    }
+    size_t wasted_bytes() const noexcept;
+};
+
+#endif    // SEGMENTINDEX_H
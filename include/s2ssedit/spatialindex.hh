@@ -0,0 +1,63 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) Flamewing 2011-2019 <flamewing.sonic@gmail.com>
+ *
+ * S2-SSEdit is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * S2-SSEdit is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPATIALINDEX_H
+#define SPATIALINDEX_H
+
+#include "s2ssedit/object.hh"
+#include "s2ssedit/sslevelobjs.hh"
+
+#include <cstdint>
+#include <vector>
+
+// Grid over a whole stage for finding the object under the pointer. Cells
+// are keyed by (global row, angle / 8) and hold one bit per angle, so a hit
+// test looks at a fixed number of cells no matter how dense the stage is.
+// The grid is kept up to date by segment revision: only segments that have
+// changed since the last sync are refilled.
+class spatial_index {
+private:
+    static constexpr const unsigned angles_per_cell = 8;
+    static constexpr const unsigned cells_per_row   = 256 / angles_per_cell;
+
+    struct cell {
+        uint8_t occupied = 0;
+        uint8_t bombs    = 0;
+    };
+
+    std::vector<cell>     cells;
+    std::vector<size_t>   segstart;
+    std::vector<uint16_t> row_segment;
+    std::vector<uint64_t> revisions;
+
+    bool same_layout(sslevels const& stage) const noexcept;
+    void relayout(sslevels const& stage);
+    void fill_segment(sssegments const& seg, size_t index);
+
+public:
+    // Brings the grid up to date with the stage.
+    void sync(sslevels const& stage);
+    void clear() noexcept;
+    // Object drawn over point (x, y) of the stage, with y counted in pixels
+    // from the start of the stage. When several objects cover the point,
+    // the one with the smallest angle wins. Returns an invalid object if
+    // there is none.
+    object hit_test(int x, int y) const noexcept;
+};
+
+#endif    // SPATIALINDEX_H
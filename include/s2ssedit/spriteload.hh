@@ -0,0 +1,95 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) Flamewing 2011-2019 <flamewing.sonic@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPRITELOAD_H
+#define SPRITELOAD_H
+
+#include "s2ssedit/sslevelobjs.hh"
+
+#include <cstdint>
+#include <vector>
+
+// Estimated sprite load along a stage. The game draws every object, and the
+// shadow of every object on the ground, that is in the part of the tube in
+// view; so for each row, this counts the rings, bombs and shadows in the
+// window of rows starting there that the game shows at once.
+class sprite_load {
+public:
+    struct counts {
+        unsigned rings   = 0;
+        unsigned bombs   = 0;
+        unsigned shadows = 0;
+
+        unsigned total() const noexcept {
+            return rings + bombs + shadows;
+        }
+        counts& operator+=(counts const& other) noexcept {
+            rings += other.rings;
+            bombs += other.bombs;
+            shadows += other.shadows;
+            return *this;
+        }
+        counts& operator-=(counts const& other) noexcept {
+            rings -= other.rings;
+            bombs -= other.bombs;
+            shadows -= other.shadows;
+            return *this;
+        }
+    };
+    // The per-segment object limit assumes a segment is about what is in
+    // view; the window extends it to clusters that straddle segments.
+    static constexpr const int default_depth = sssegments::eTurnThenRiseLen;
+
+private:
+    int depth;
+    // Layout and segment revisions the estimate was made for.
+    std::vector<int>      segpos;
+    std::vector<uint64_t> revisions;
+    // Objects on each row, and in the window starting at each row.
+    std::vector<counts> rows;
+    std::vector<counts> windows;
+
+    void fill_rows(sssegments const& seg, size_t start);
+    void sum_windows(size_t first, size_t last);
+
+public:
+    explicit sprite_load(int d = default_depth) noexcept : depth(d) {}
+
+    // Brings the estimate up to date with the stage, and returns true if it
+    // changed. Only the windows overlapping segments changed since the last
+    // call are summed again, unless segments were added or removed.
+    bool update(sslevels const& stage);
+    void clear() noexcept {
+        segpos.clear();
+        revisions.clear();
+        rows.clear();
+        windows.clear();
+    }
+
+    int get_depth() const noexcept {
+        return depth;
+    }
+    size_t size() const noexcept {
+        return windows.size();
+    }
+    counts const& operator[](size_t row) const noexcept {
+        return windows[row];
+    }
+};
+
+#endif    // SPRITELOAD_H
@@ -20,36 +20,28 @@
 #define SSEDITOR_H
 
 #include "s2ssedit/abstractaction.hh"
+#include "s2ssedit/formationsearch.hh"
 #include "s2ssedit/object.hh"
+#include "s2ssedit/objectpayload.hh"
+#include "s2ssedit/objectquery.hh"
+#include "s2ssedit/overlapfinder.hh"
+#include "s2ssedit/patternlibrary.hh"
+#include "s2ssedit/segmentindex.hh"
 #include "s2ssedit/ssobjfile.hh"
+#include "s2ssedit/spatialindex.hh"
+#include "s2ssedit/spriteload.hh"
+#include "s2ssedit/ssrenderer.hh"
+#include "s2ssedit/stagebitmap.hh"
+#include "s2ssedit/stagestats.hh"
+#include "s2ssedit/stagevalidator.hh"
+#include "s2ssedit/undohistory.hh"
 
 #include <gtkmm.h>
 
 #include <array>
-#include <deque>
 #include <memory>
-#include <set>
 #include <tuple>
-
-#define SIMAGE_SIZE        16
-#define IMAGE_SIZE         16U
-#define HALF_IMAGE_SIZE    8
-#define QUARTER_IMAGE_SIZE 4
-
-constexpr const int32_t center_x    = 0x40;
-constexpr const int32_t right_angle = 0x80;
-
-inline int32_t angle_simple(int angle) {
-    return (angle + center_x) % 256;
-}
-
-inline int32_t angle_normal(int angle) {
-    return (angle + center_x + right_angle) % 256;
-}
-
-inline int angle_to_x(int angle) {
-    return ((angle + center_x) % 256) * 2 + 4;
-}
+#include <unordered_map>
 
 inline uint8_t x_to_angle(int32_t x, bool constrain, int32_t snapoff = 0U) {
     int32_t angle = x + (x % 2) - 4;
@@ -123,28 +115,143 @@ class sseditor {
         eLozenge,
         eStar,
         eTriangle,
+        ePattern,
         eNumInsertModes
     };
 
     InsertModes ringmode, bombmode;
 
-    std::set<object> selection, hotstack, insertstack, sourcestack, copystack;
+    // How the result of a query is combined with the selection.
+    enum QueryModes {
+        eReplaceSelection = 0,
+        eAddToSelection,
+        eRemoveFromSelection,
+        eIntersectSelection
+    };
+
+    object_set selection, hotstack, insertstack, sourcestack;
+
+    // Bitmaps of the selection and hotstack, rebuilt only when the revision
+    // of the set changes; used for fast membership tests. A rebuild only
+    // touches the rows the set spans, so the hotstack bitmap stays cheap
+    // while dragging a selection box.
+    struct object_mask {
+        stage_bitmap bits;
+        uint64_t     revision = 0;
+    };
+    object_mask selection_mask, hotstack_mask;
+
+    // Last shape built in insert mode, as (row, angle) offsets from the start
+    // of the drag. It is rebuilt only when its parameters change; otherwise
+    // it is translated to the new origin, or left alone if that did not move
+    // either.
+    struct insert_shape {
+        using offset = std::pair<int, int>;
+        InsertModes         submode    = eNumInsertModes;
+        int                 dpos       = 0;
+        int                 angledelta = 0;
+        bool                grid       = false;
+        size_t              pattern    = 0;
+        std::vector<offset> offsets;
+        // Where the offsets were last placed, and the result.
+        ObjectTypes type     = sssegments::eRing;
+        int         pos0     = 0;
+        int         angle0   = 0;
+        uint64_t    revision = 0;
+    } shape;
+
+    // Last query used to select objects, offered again the next time.
+    object_query last_query;
+    QueryModes   query_mode;
+    // Gaps and scope of the last search for overlapping objects.
+    overlap_finder overlaps;
+    bool           overlaps_all_stages;
+    // Scope of the last search for a formation.
+    bool formation_all_stages;
 
     object hotspot, lastclick, selclear, boxcorner;
 
-    std::shared_ptr<sslevels>   copylevel;
-    std::shared_ptr<sssegments> copyseg;
+    // Grid for finding the object under the pointer in the current stage.
+    spatial_index hitgrid;
+
+    // Copied objects, as rows relative to the top of the view when copied.
+    std::vector<object_payload::object_row> copyrows;
+    std::shared_ptr<sslevels>               copylevel;
+    std::shared_ptr<sssegments>             copyseg;
+
+    // The last copy is also published to the system clipboard, and only
+    // encoded when another editor asks for it. clipboard_targets tells
+    // which kinds of data the clipboard holds, whoever owns it.
+    bool                                        clipboard_owner;
+    std::array<bool, object_payload::eNumKinds> clipboard_targets;
 
-    int  copypos;
+    // Offset of the drag in progress, in angle and stage rows.
+    int  drag_dangle, drag_dpos;
     bool drawbox;
     bool snaptogrid;
 
-    std::deque<std::shared_ptr<abstract_action>> undostack, redostack;
+    // Formations for the pattern insert mode, and the one in use.
+    pattern_library patterns;
+    size_t          current_pattern;
+
+    undo_history history;
+    // Log of unsaved edits, kept next to the project for crash recovery.
+    edit_journal journal;
+    std::string  project_dir;
+
+    // Set when the stage data changes; the next update() then brings the
+    // problems and totals up to date, and clears it.
+    bool stages_dirty;
+
+    // Problems in the whole project; the list shows them, and remembers
+    // which one each row is.
+    stage_validator validator;
+    struct problem_columns : Gtk::TreeModelColumnRecord {
+        Gtk::TreeModelColumn<Glib::ustring> where;
+        Gtk::TreeModelColumn<Glib::ustring> problem;
+        Gtk::TreeModelColumn<unsigned>      index;
+        problem_columns() {
+            add(where);
+            add(problem);
+            add(index);
+        }
+    } problem_cols;
+    Glib::RefPtr<Gtk::ListStore> problemstore;
 
     std::vector<int> segpos;
 
     int endpos;
 
+    // Minimap state: zoom level (0 fits the whole stage) and the cache of
+    // rendered segments, keyed by segment revision.
+    unsigned minimap_zoom;
+    double   minimap_scale, minimap_top;
+    int      minimap_tile_width;
+    double   minimap_tile_scale;
+    std::unordered_map<uint64_t, Cairo::RefPtr<Cairo::ImageSurface>>
+            minimap_tiles;
+
+    // Object totals of each stage, by segment and checkpoint; the one of
+    // the current stage is brought up to date after a change. The labels
+    // are only refilled when the totals, the stage or the interval shown
+    // change; totals_stage is ~0U when they show no stage.
+    std::vector<stage_stats> stats;
+    unsigned                 totals_stage;
+    size_t                   totals_interval;
+
+    // Identical segments of the whole project, found again on request.
+    segment_index duplicates;
+
+    // Sprite load of the current stage, shown as a strip next to the view;
+    // kept up to date as the strip is drawn.
+    sprite_load sprite_estimate;
+
+    // Playback state: fractional row being shown, speed multiplier, and the
+    // frame clock time (in microseconds) of the previous tick.
+    double play_row, play_speed;
+    gint64 play_last_time;
+    guint  play_tick_id;
+
     // GUI variables.
     Gtk::Window*                   main_win;
     Glib::RefPtr<Gtk::Application> kit;
@@ -153,31 +260,48 @@ class sseditor {
     Gtk::FileChooserDialog*        filedlg;
     Glib::RefPtr<Gtk::Builder>     builder;
     Glib::RefPtr<Gdk::Pixbuf>      ringimg, bombimg;
+    std::unique_ptr<ssrenderer>    renderer;
+    // Only allocated while profiling is enabled.
+    std::unique_ptr<render_profile> profile;
 
     Cairo::RefPtr<Cairo::Pattern> drawimg;
 
     Glib::RefPtr<Gtk::FileFilter> pfilefilter;
     Gtk::DrawingArea*             pspecialstageobjs;
+    Gtk::DrawingArea*             pminimap;
+    Gtk::DrawingArea*             ploadstrip;
     Gtk::Notebook*                pmodenotebook;
     // Labels
     Gtk::Label *plabelcurrentstage, *plabeltotalstages, *plabelcurrentsegment,
             *plabeltotalsegments, *plabelcurrsegrings, *plabelcurrsegbombs,
-            *plabelcurrsegshadows, *plabelcurrsegtotal;
+            *plabelcurrsegshadows, *plabelcurrsegtotal, *plabelstagetotals,
+            *plabelcheckpointtotals;
     Gtk::Image* pimagecurrsegwarn;
+    // Problems panel
+    Gtk::TreeView* pproblemsview;
+    Gtk::Label*    plabelproblems;
     // Scrollbar
     Gtk::Scrollbar* pvscrollbar;
     // Main toolbar
     Gtk::ToolButton *popenfilebutton, *psavefilebutton, *prevertfilebutton,
-            *pundobutton, *predobutton, *phelpbutton, *paboutbutton,
-            *pquitbutton;
+            *pduplicatesbutton, *pundobutton, *predobutton, *phelpbutton,
+            *paboutbutton, *pquitbutton;
     std::array<Gtk::RadioToolButton*, eNumModes> pmodebuttons;
     Gtk::ToggleToolButton*                       psnapgridbutton;
+    Gtk::ToggleToolButton*                       pplaybutton;
+    Gtk::SpinButton*                             pplayspeed;
+    Gtk::Label*                                  plabelplayrow;
+    Gtk::Label*                                  plabelundo;
     // Selection toolbar
-    Gtk::ToolButton *pcutbutton, *pcopybutton, *ppastebutton, *pdeletebutton;
+    Gtk::ToolButton *pcutbutton, *pcopybutton, *ppastebutton, *pdeletebutton,
+            *pquerybutton, *psavepatternbutton, *poverlapbutton,
+            *pfindformationbutton;
     // Insert ring toolbar
     std::array<Gtk::RadioToolButton*, eNumInsertModes> pringmodebuttons;
+    Gtk::ComboBoxText*                                 pringpatterncombo;
     // Insert bomb toolbar
     std::array<Gtk::RadioToolButton*, eNumInsertModes> pbombmodebuttons;
+    Gtk::ComboBoxText*                                 pbombpatterncombo;
     // Special stage toolbar
     Gtk::Toolbar*    pstage_toolbar;
     Gtk::ToolButton *pfirst_stage_button, *pprevious_stage_button,
@@ -205,9 +329,23 @@ class sseditor {
     Gtk::Button *     pmoveup, *pmovedown, *pmoveleft, *pmoveright;
     Gtk::RadioButton *pringtype, *pbombtype;
 
+    static stage_bitmap const& get_mask(
+            object_set const& objs, object_mask& mask) {
+        if (mask.revision != objs.get_revision()) {
+            mask.bits.assign(objs);
+            mask.revision = objs.get_revision();
+        }
+        return mask.bits;
+    }
+    bool is_selected(object const& obj) {
+        return get_mask(selection, selection_mask).test(obj);
+    }
+
     bool move_object(int dx, int dy);
     void render() const {
         pspecialstageobjs->queue_draw();
+        pminimap->queue_draw();
+        ploadstrip->queue_draw();
     }
     void show();
 
@@ -220,7 +358,7 @@ class sseditor {
                * SIMAGE_SIZE;
     }
     void draw_outlines(
-            std::set<object>& col, Cairo::RefPtr<Cairo::Context> const& cr) {
+            object_set& col, Cairo::RefPtr<Cairo::Context> const& cr) {
         for (auto const& elem : col) {
             auto tx = get_obj_x(elem);
             auto ty = get_obj_y(elem);
@@ -229,10 +367,10 @@ class sseditor {
         }
     }
     void draw_outlines(
-            std::set<object>& col1, std::set<object>& col2,
+            object_set& col1, stage_bitmap const& mask2,
             Cairo::RefPtr<Cairo::Context> const& cr) {
         for (auto const& elem : col1) {
-            if (col2.find(elem) != col2.end()) {
+            if (mask2.test(elem)) {
                 continue;
             }
             auto tx = get_obj_x(elem);
@@ -241,8 +379,7 @@ class sseditor {
             cr->stroke();
         }
     }
-    void draw_x(
-            std::set<object>& col1, Cairo::RefPtr<Cairo::Context> const& cr) {
+    void draw_x(object_set& col1, Cairo::RefPtr<Cairo::Context> const& cr) {
         for (auto const& elem : col1) {
             auto tx = get_obj_x(elem);
             auto ty = get_obj_y(elem);
@@ -255,7 +392,7 @@ class sseditor {
         }
     }
     void draw_objects(
-            std::set<object>& col, Cairo::RefPtr<Cairo::Context> const& cr) {
+            object_set& col, Cairo::RefPtr<Cairo::Context> const& cr) {
         for (auto const& elem : col) {
             Glib::RefPtr<Gdk::Pixbuf> image
                     = (elem.get_type() == sssegments::eBomb) ? bombimg
@@ -273,32 +410,29 @@ class sseditor {
             cr->stroke();
         }
     }
-    void object_triangle(
-            int x, int y, int dx, int dy, int h, sssegments::ObjectTypes type,
-            bool fill, std::set<object>& col);
+    void shape_triangle(int y, int dx, int dy, int h, bool fill);
     void   update_segment_positions(bool setpos);
     size_t get_current_segment() const;
     size_t find_segment(int pos) const;
+    object drag_target(object obj) const;
     void   goto_segment(unsigned seg) {
         currsegment = seg;
         pvscrollbar->set_value(segpos[seg]);
     }
+    // Actions done between begin_edits and commit_edits are applied as they
+    // come, so each sees the ones before it, but are undone as one step,
+    // with a single refresh; update() does nothing meanwhile. Transactions
+    // may nest.
+    void begin_edits() noexcept {
+        history.begin();
+    }
+    void commit_edits();
     template <typename Act, typename... Args>
     void do_action(Args&&... args) {
-        using MergeResult = abstract_action::MergeResult;
-        redostack.clear();
-        auto act = std::make_shared<Act>(std::forward<Args>(args)...);
-        if (undostack.empty()) {
-            undostack.push_front(act);
-        } else {
-            const MergeResult ret = undostack.front()->merge(act);
-            if (ret == abstract_action::eNoMerge) {
-                undostack.push_front(act);
-            } else if (ret == abstract_action::eDeleteAction) {
-                undostack.pop_front();
-            }
-        }
-        act->apply(specialstages, static_cast<std::set<object>*>(nullptr));
+        history.apply<Act>(
+                specialstages, static_cast<object_set*>(nullptr),
+                std::forward<Args>(args)...);
+        stages_dirty = true;
     }
     int get_scroll() const {
         return static_cast<int>(pvscrollbar->get_value());
@@ -308,6 +442,9 @@ class sseditor {
     sseditor(Glib::RefPtr<Gtk::Application> application, char const* uifile);
 
     void run();
+    void set_undo_limits(undo_history::limits const& lim) {
+        history.set_limits(lim);
+    }
 
     bool on_specialstageobjs_configure_event(GdkEventConfigure* event);
     void on_specialstageobjs_drag_data_received(
@@ -332,6 +469,13 @@ class sseditor {
     bool on_drag_motion(
             Glib::RefPtr<Gdk::DragContext> const& context, int x, int y,
             guint time);
+    // Minimap
+    bool on_minimap_draw(Cairo::RefPtr<Cairo::Context> const& cr);
+    bool on_minimap_button_press_event(GdkEventButton* event);
+    bool on_minimap_motion_notify_event(GdkEventMotion* event);
+    bool on_minimap_scroll_event(GdkEventScroll* event);
+    // Sprite load strip
+    bool on_loadstrip_draw(Cairo::RefPtr<Cairo::Context> const& cr);
     // Scrollbar
     void on_vscrollbar_value_changed();
     // Main toolbar
@@ -339,6 +483,7 @@ class sseditor {
     void on_openfilebutton_clicked();
     void on_savefilebutton_clicked();
     void on_revertfilebutton_clicked();
+    void on_duplicatesbutton_clicked();
     void on_undobutton_clicked();
     void on_redobutton_clicked();
     template <EditModes N>
@@ -354,6 +499,10 @@ class sseditor {
     void on_snapgridbutton_toggled() {
         snaptogrid = psnapgridbutton->get_active();
     }
+    void on_playbutton_toggled();
+    void on_playspeed_value_changed() {
+        play_speed = pplayspeed->get_value();
+    }
     bool want_snap_to_grid(guint istate) const noexcept {
         return static_cast<unsigned int>(snaptogrid)
                != (istate & GDK_CONTROL_MASK);
@@ -368,6 +517,10 @@ class sseditor {
     void on_copybutton_clicked();
     void on_pastebutton_clicked();
     void on_deletebutton_clicked();
+    void on_querybutton_clicked();
+    void on_savepatternbutton_clicked();
+    void on_overlapbutton_clicked();
+    void on_findformationbutton_clicked();
     // Insert ring toolbar
     template <InsertModes N>
     void on_ringmode_toggled() {
@@ -380,6 +533,16 @@ class sseditor {
         bombmode = N;
         update();
     }
+    void on_patterncombo_changed(Gtk::ComboBoxText* combo);
+    void on_ringpatterncombo_changed() {
+        on_patterncombo_changed(pringpatterncombo);
+    }
+    void on_bombpatterncombo_changed() {
+        on_patterncombo_changed(pbombpatterncombo);
+    }
+    // Problems panel
+    void on_problemsview_row_activated(
+            Gtk::TreePath const& path, Gtk::TreeViewColumn* column);
     // Special stage toolbar
     void on_first_stage_button_clicked();
     void on_previous_stage_button_clicked();
@@ -470,7 +633,7 @@ class sseditor {
             return;
         }
         do_action<alter_selection_action>(currstage, N, selection);
-        std::set<object> temp;
+        object_set temp;
         // sslevels *currlvl = specialstages->get_stage(currstage);
         for (auto const& elem : selection) {
             // sssegments *currseg = currlvl->get_segment(it->get_segment());
@@ -489,8 +652,12 @@ class sseditor {
     T get_obj_pos(object obj) const {
         return static_cast<T>(segpos[obj.get_segment()] + obj.get_pos());
     }
-    void delete_set(std::set<object>& toDel);
-    void delete_set(std::set<object>&& toDel);
+    // Replaces each match by repl, anchored where the match is.
+    void replace_formation(
+            std::vector<formation_match> const& matches,
+            insert_pattern const&               repl);
+    void delete_set(object_set& toDel);
+    void delete_set(object_set&& toDel);
     void delete_existing_object(int seg, unsigned pos, unsigned angle);
     void delete_object(int seg, unsigned x, unsigned y, ObjectTypes t) {
         delete_set({object(seg, x, y, t)});
@@ -570,6 +737,9 @@ class sseditor {
             ins = eTriangle;
             break;
         case eTriangle:
+            ins = ePattern;
+            break;
+        case ePattern:
             ins = eSingle;
             break;
         case eNumInsertModes:
@@ -579,7 +749,7 @@ class sseditor {
     static void decrement_insertmode(InsertModes& ins) {
         switch (ins) {
         case eSingle:
-            ins = eTriangle;
+            ins = ePattern;
             break;
         case eLine:
             ins = eSingle;
@@ -602,18 +772,60 @@ class sseditor {
         case eTriangle:
             ins = eStar;
             break;
+        case ePattern:
+            ins = eTriangle;
+            break;
         case eNumInsertModes:
             __builtin_unreachable();
         }
     }
 
-    void draw_balls(Cairo::RefPtr<Cairo::Context> const& cr, int ty) const;
+    void update_minimap_scale(int width, int height);
+    Cairo::RefPtr<Cairo::ImageSurface> get_minimap_tile(
+            sssegments const& seg);
+    void minimap_jump(double y);
+
+    bool playing() const noexcept {
+        return play_tick_id != 0;
+    }
+    void start_playback();
+    void stop_playback();
+    bool on_playback_tick(Glib::RefPtr<Gdk::FrameClock> const& clock);
+    void update_play_label();
+    void update_undo_label();
+    void update_stage_totals();
+    void update_problems();
+    void goto_issue(validation_issue const& issue);
+    void open_journal();
+
+    void copy_selection();
+    void publish_clipboard(object_payload::Kinds kind);
+    bool paste_from_clipboard(object_payload::Kinds kind);
+    void paste_objects(std::vector<object_payload::object_row> const& rows);
+    void paste_segment(sssegments const& sgm);
+    void paste_stage(sslevels const& lvl);
+    void on_clipboard_get(Gtk::SelectionData& selection_data, guint info);
+    void on_clipboard_clear() {
+        clipboard_owner = false;
+    }
+    void on_clipboard_owner_change(GdkEventOwnerChange* event);
+    void on_clipboard_targets(std::vector<Glib::ustring> const& targets);
+    void on_clipboard_received(Gtk::SelectionData const& selection_data);
+    bool on_journal_timeout() {
+        journal.sync();
+        if (journal.take_error()) {
+            report_journal_error();
+        }
+        return true;
+    }
+    void report_journal_error();
+
+    void toggle_profile();
+    void save_profile();
 
     void cleanup_render(Cairo::RefPtr<Cairo::Context> const& cr);
-    void draw_objects(
-            Cairo::RefPtr<Cairo::Context> const& cr, int start, int end);
-    bool want_checkerboard(int row, int seg, sssegments* currseg);
     void draw_box(Cairo::RefPtr<Cairo::Context> const& cr);
+    void draw_overlays(Cairo::RefPtr<Cairo::Context> const& cr);
     void select_hotspot();
     void fix_stage(unsigned numstages) {
         if (numstages == 0) {
@@ -660,7 +872,7 @@ class sseditor {
     Gtk::RadioButton* direction_button(bool dir) {
         return dir ? psegment_left : psegment_right;
     }
-    static std::pair<size_t, size_t> count_objects(std::set<object>& objs) {
+    static std::pair<size_t, size_t> count_objects(object_set& objs) {
         size_t nrings = 0;
         size_t nbombs = 0;
         for (auto const& elem : objs) {
@@ -699,21 +911,16 @@ class sseditor {
     void motion_update_insertion(
             int dangle, int dpos, int pos0, int pos1, int angle0, int angle1,
             bool grid, bool lbutton_pressed);
-    void motion_update_line(
-            int dpos, int pos0, int pos1, int angle0, ObjectTypes type,
-            int angledelta);
-    void motion_update_loop(
-            int dpos, int pos0, int angle0, ObjectTypes type, int angledelta,
-            bool grid);
-    void motion_update_zigzag(
-            int dpos, int pos0, int pos1, int angle0, ObjectTypes type,
-            int angledelta);
-    void motion_update_diamond(
-            int dpos, int pos0, int pos1, int angle0, ObjectTypes type,
-            int angledelta);
-    void motion_update_star_lozenge(
-            int dpos, int pos0, int pos1, int angle0, ObjectTypes type,
-            int angledelta, bool fill);
+    void shape_line(int dpos, int angledelta);
+    void shape_loop(int dpos, int angledelta, bool grid);
+    void shape_zigzag(int dpos, int angledelta);
+    void shape_diamond(int dpos, int angledelta);
+    void shape_star_lozenge(int dpos, int angledelta, bool fill);
+    void build_insert_shape(InsertModes submode, int dpos, int angledelta);
+    void place_insert_shape(int pos0, int angle0, ObjectTypes type);
+    void place_pattern(int pos1, int angle1, ObjectTypes type);
+    void load_patterns(std::string const& datafile);
+    void fill_pattern_combos();
     void scroll_into_view(GdkEventMotion* event);
 
     static int motion_compute_angledelta(
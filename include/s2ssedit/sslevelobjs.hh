@@ -22,24 +22,51 @@
 #include "s2ssedit/sssegmentobjs.hh"
 
 #include <istream>
+#include <memory>
 #include <ostream>
 #include <vector>
 
 class sslevels {
 private:
-    std::vector<sssegments> segments;
+    // Segments are shared between copies of the stage, and only copied
+    // when one of them is about to change them; copying the segments in
+    // turn shares their objects.
+    using segment_list = std::vector<sssegments>;
+    std::shared_ptr<segment_list> segments;
+
+    segment_list const& get_segments() const noexcept {
+        static segment_list const empty;
+        return segments ? *segments : empty;
+    }
+    segment_list& own_segments() {
+        if (!segments) {
+            segments = std::make_shared<segment_list>();
+        } else if (segments.use_count() > 1) {
+            segments = std::make_shared<segment_list>(*segments);
+        }
+        return *segments;
+    }
 
 public:
     size_t size() const;
+    // Approximate heap memory used by the segments of the stage; segments
+    // shared with copies count for their share only.
+    size_t heap_size() const noexcept;
 
     void read(std::istream& in, std::istream& lay, int term, int term2);
-    void write(std::ostream& out, std::ostream& lay) const;
+    void write(
+            std::ostream& out, std::ostream& lay,
+            sssegments::ObjectOrders order = sssegments::eAngleOrder) const;
+    // The segment count, then each segment in a single stream.
+    void read(std::istream& in);
+    void write(std::ostream& out) const;
 
     size_t fill_position_array(std::vector<int>& segpos) const {
+        segment_list const& segs = get_segments();
         segpos.clear();
-        segpos.reserve(segments.size());
+        segpos.reserve(segs.size());
         size_t tally = 0;
-        for (auto const& elem : segments) {
+        for (auto const& elem : segs) {
             segpos.push_back(tally);
             tally += elem.get_length();
         }
@@ -48,38 +75,46 @@ class sslevels {
     }
 
     size_t num_segments() const {
-        return segments.size();
+        return get_segments().size();
     }
     sssegments* get_segment(size_t s) {
-        return &(segments[s]);
+        return &(own_segments()[s]);
+    }
+    sssegments const* get_segment(size_t s) const {
+        return &(get_segments()[s]);
     }
     sssegments* insert(sssegments const& lvl, size_t s) {
-        return &*(segments.insert(segments.begin() + s, lvl));
+        segment_list& segs = own_segments();
+        return &*(segs.insert(segs.begin() + s, lvl));
     }
     sssegments* append(sssegments const& lvl) {
-        segments.push_back(lvl);
-        return &segments.back();
+        segment_list& segs = own_segments();
+        segs.push_back(lvl);
+        return &segs.back();
     }
     sssegments* remove(size_t s) {
-        auto it = segments.erase(segments.begin() + s);
-        if (it == segments.end()) {
-            return &segments.back();
+        segment_list& segs = own_segments();
+        auto          it   = segs.erase(segs.begin() + s);
+        if (it == segs.end()) {
+            return &segs.back();
         }
         return &*it;
     }
     sssegments* move_left(size_t s) {
+        segment_list& segs = own_segments();
         if (s == 0) {
-            return &segments.front();
+            return &segs.front();
         }
-        std::swap(segments[s - 1], segments[s]);
-        return &segments[s - 1];
+        std::swap(segs[s - 1], segs[s]);
+        return &segs[s - 1];
     }
     sssegments* move_right(size_t s) {
-        if (s >= segments.size() - 1) {
-            return &segments.back();
+        segment_list& segs = own_segments();
+        if (s >= segs.size() - 1) {
+            return &segs.back();
         }
-        std::swap(segments[s], segments[s + 1]);
-        return &segments[s + 1];
+        std::swap(segs[s], segs[s + 1]);
+        return &segs[s + 1];
     }
 };
 
@@ -34,12 +34,15 @@
 class ssobj_file {
 private:
     void read_internal(std::istream& objfile, std::istream& layfile);
-    void write_internal(std::ostream& objfile, std::ostream& layfile) const;
+    void write_internal(
+            std::ostream& objfile, std::ostream& layfile,
+            sssegments::ObjectOrders order) const;
 
-    std::vector<sslevels> stages;
-    std::string           layoutfile;
-    std::string           objectfile;
-    bool                  error;
+    std::vector<sslevels>    stages;
+    std::string              layoutfile;
+    std::string              objectfile;
+    bool                     error;
+    sssegments::ObjectOrders order = sssegments::eAngleOrder;
 
 public:
     explicit ssobj_file(std::string const& dir);
@@ -47,6 +50,18 @@ class ssobj_file {
 
     void read();
     void write() const;
+    // Size of the compressed object file on disk, and what it would be if
+    // written now with the given order.
+    size_t stored_size() const;
+    size_t compressed_size(sssegments::ObjectOrders ord) const;
+
+    // Order of the objects of each row when writing.
+    sssegments::ObjectOrders get_object_order() const noexcept {
+        return order;
+    }
+    void set_object_order(sssegments::ObjectOrders ord) noexcept {
+        order = ord;
+    }
 
     size_t num_stages() const {
         return stages.size();
@@ -54,6 +69,9 @@ class ssobj_file {
     sslevels* get_stage(size_t s) {
         return &(stages[s]);
     }
+    sslevels const* get_stage(size_t s) const {
+        return &(stages[s]);
+    }
     sslevels* insert(sslevels const& lvl, size_t s) {
         return &*(stages.insert(stages.begin() + s, lvl));
     }
@@ -0,0 +1,118 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) Flamewing 2011-2019 <flamewing.sonic@gmail.com>
+ *
+ * S2-SSEdit is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * S2-SSEdit is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SSRENDERER_H
+#define SSRENDERER_H
+
+#include "s2ssedit/renderprofile.hh"
+#include "s2ssedit/sslevelobjs.hh"
+
+#include <cairomm/context.h>
+#include <cairomm/surface.h>
+
+#include <string>
+#include <vector>
+
+#define SIMAGE_SIZE        16
+#define IMAGE_SIZE         16U
+#define HALF_IMAGE_SIZE    8
+#define QUARTER_IMAGE_SIZE 4
+
+constexpr const int32_t center_x    = 0x40;
+constexpr const int32_t right_angle = 0x80;
+
+inline int32_t angle_simple(int angle) {
+    return (angle + center_x) % 256;
+}
+
+inline int32_t angle_normal(int angle) {
+    return (angle + center_x + right_angle) % 256;
+}
+
+inline int angle_to_x(int angle) {
+    return ((angle + center_x) % 256) * 2 + 4;
+}
+
+// Draws a special stage onto any Cairo context. It only depends on Cairo, so
+// it works the same for the editor window and for offscreen image surfaces.
+class ssrenderer {
+private:
+    Cairo::RefPtr<Cairo::ImageSurface> ringimg, bombimg;
+
+    sslevels const*  level = nullptr;
+    size_t           palette = 0;
+    std::vector<int> segpos;
+    int              endpos = 0;
+    render_profile*  profile = nullptr;
+
+    // The background only depends on the palette and the canvas size, so it
+    // is drawn once and then blitted; whole stage renders paint it directly.
+    mutable Cairo::RefPtr<Cairo::ImageSurface> background;
+    mutable size_t                             background_palette = 0;
+    mutable bool                               background_tube    = false;
+    // Beams and balls look the same on every fourth row, so they are drawn
+    // once into a strip that is then blitted on each of those rows.
+    mutable Cairo::RefPtr<Cairo::ImageSurface> beam_strip;
+    mutable size_t                             strip_palette = 0;
+
+    size_t find_segment(int row) const;
+    void   paint_background(
+              Cairo::RefPtr<Cairo::Context> const& cr, int width,
+              int height) const;
+    bool   want_checkerboard(
+              int row, size_t seg, sssegments const& currseg) const;
+    void draw_balls(Cairo::RefPtr<Cairo::Context> const& cr, int ty) const;
+    void paint_beams(Cairo::RefPtr<Cairo::Context> const& cr, int ty) const;
+    Cairo::RefPtr<Cairo::ImageSurface> get_beam_strip(int width) const;
+
+public:
+    // Width of the editor's drawing area, which fits the whole tube.
+    static constexpr const int default_width = 520;
+
+    ssrenderer(std::string const& ringfile, std::string const& bombfile);
+
+    // Must be called again if segments are added, removed or moved.
+    void set_stage(sslevels const* lvl, unsigned index);
+    int  get_length() const noexcept {
+        return endpos;
+    }
+    // Optional; when set, drawing time is charged to its phases.
+    void set_profile(render_profile* prof) noexcept {
+        profile = prof;
+    }
+
+    // Tube, area outside of the tube and lane dividers.
+    void draw_background(
+            Cairo::RefPtr<Cairo::Context> const& cr, int width,
+            int height) const;
+    // Beams, balls, checkerboards and segment dividers.
+    void draw_rows(
+            Cairo::RefPtr<Cairo::Context> const& cr, int start, int end,
+            int scroll, int width) const;
+    void draw_objects(
+            Cairo::RefPtr<Cairo::Context> const& cr, int start, int end,
+            int scroll) const;
+    // All of the above, with row 'scroll' at the top.
+    void draw(
+            Cairo::RefPtr<Cairo::Context> const& cr, int scroll, int width,
+            int height) const;
+    // Whole stage on a new image surface, scaled by the given factor.
+    Cairo::RefPtr<Cairo::ImageSurface> render_stage(double scale) const;
+};
+
+#endif    // SSRENDERER_H
@@ -21,8 +21,10 @@
 
 #include "s2ssedit/ignore_unused_variable_warning.hh"
 
+#include <atomic>
 #include <istream>
 #include <map>
+#include <memory>
 #include <ostream>
 
 class sssegments {
@@ -52,6 +54,15 @@ class sssegments {
         eGeomMask = 0x7fU,
         eFlipMask = 0x80U
     };
+    // Order of the objects within each row of the object file. Rows are
+    // always written in order, as in the original data, but the game does
+    // not care about the order within a row, and some compress better.
+    enum ObjectOrders : uint8_t {
+        eAngleOrder = 0,
+        eReverseAngleOrder,
+        eRingsFirstOrder,
+        eNumObjectOrders
+    };
     enum SegmentSizes : uint32_t {
         eTurnThenRiseLen     = 24,
         eTurnThenDropLen     = 24,
@@ -66,6 +77,7 @@ class sssegments {
         return (angle & eOnAirMask) != 0;
     }
     void add_obj(uint8_t angle, ObjectTypes type) noexcept {
+        touch();
         if (!is_aerial(angle)) {
             numshadows++;
         }
@@ -76,6 +88,7 @@ class sssegments {
         }
     }
     void del_obj(uint8_t angle, ObjectTypes type) noexcept {
+        touch();
         if (!is_aerial(angle)) {
             numshadows--;
         }
@@ -87,16 +100,44 @@ class sssegments {
     }
 
 private:
-    segobjs         objects;
+    // Source of unique revision numbers; every change to a segment takes a
+    // fresh one, so caches can be keyed on it and copies share it.
+    static std::atomic<uint64_t> last_revision;
+
+    void touch() noexcept {
+        revision = ++last_revision;
+    }
+
+    // Objects are shared between copies of the segment, and only copied
+    // when one of them is about to change them.
+    using segobjs_ptr = std::shared_ptr<segobjs>;
+    static segobjs const& no_objects() noexcept {
+        static segobjs const empty;
+        return empty;
+    }
+    segobjs& own_objects() {
+        if (!objects) {
+            objects = std::make_shared<segobjs>();
+        } else if (objects.use_count() > 1) {
+            objects = std::make_shared<segobjs>(*objects);
+        }
+        return *objects;
+    }
+
+    segobjs_ptr     objects;
     bool            flip       = false;
     SegmentTypes    terminator = eNormalSegment;
     SegmentGeometry geometry   = eStraight;
     uint16_t        numrings   = 0;
     uint16_t        numbombs   = 0;
     uint16_t        numshadows = 0;
+    uint64_t        revision   = 0;
 
 public:
     size_t size() const;
+    // Approximate heap memory used by the objects of the segment; objects
+    // shared with copies count for their share only.
+    size_t heap_size() const noexcept;
 
     uint16_t get_numrings() const noexcept {
         return numrings;
@@ -110,6 +151,9 @@ class sssegments {
     uint16_t get_totalobjs() const noexcept {
         return numrings + numbombs + numshadows;
     }
+    uint64_t get_revision() const noexcept {
+        return revision;
+    }
     SegmentTypes get_type() const noexcept {
         return terminator;
     }
@@ -147,25 +191,35 @@ class sssegments {
                | static_cast<uint8_t>(geometry);
     }
     void set_type(SegmentTypes t) noexcept {
-        terminator = t;
+        if (terminator != t) {
+            terminator = t;
+            touch();
+        }
     }
     void set_geometry(SegmentGeometry g) noexcept {
-        geometry = g;
+        if (geometry != g) {
+            geometry = g;
+            touch();
+        }
     }
     void set_direction(bool tf) noexcept {
-        flip = tf;
+        if (flip != tf) {
+            flip = tf;
+            touch();
+        }
     }
 
-    auto const& get_row(uint8_t row) noexcept {
-        return objects[row];
+    segobjs const& get_objects() const noexcept {
+        return objects ? *objects : no_objects();
     }
     bool exists(uint8_t row, uint8_t angle) const noexcept {
         ObjectTypes type;
         return exists(row, angle, type);
     }
     bool exists(uint8_t row, uint8_t angle, ObjectTypes& type) const noexcept {
-        auto it = objects.find(row);
-        if (it == objects.end()) {
+        segobjs const& objs = get_objects();
+        auto           it   = objs.find(row);
+        if (it == objs.end()) {
             return false;
         }
         auto const& t   = it->second;
@@ -177,47 +231,37 @@ class sssegments {
         return true;
     }
     void update(uint8_t row, uint8_t angle, ObjectTypes type, bool insert) {
-        auto it = objects.find(row);
-        if (it == objects.end()) {
-            if (!insert) {
-                return;
-            }
-            segobjs::mapped_type t;
-            t[angle]     = type;
-            objects[row] = std::move(t);
-        } else {
-            auto& t   = it->second;
-            auto  it2 = t.find(angle);
-            if (it2 == t.end()) {
-                if (!insert) {
-                    return;
-                }
-                t[angle] = type;
-            } else if (it2->second == type) {
-                return;
-            } else {
-                del_obj(angle, it2->second);
-                it2->second = type;
-            }
+        ObjectTypes oldtype;
+        bool const  found = exists(row, angle, oldtype);
+        if (found ? oldtype == type : !insert) {
+            return;
+        }
+        own_objects()[row][angle] = type;
+        if (found) {
+            del_obj(angle, oldtype);
         }
         add_obj(angle, type);
     }
-    void remove(uint8_t row, uint8_t angle) noexcept {
-        auto it = objects.find(row);
-        if (it == objects.end()) {
-            return;
-        }
-        auto& t   = it->second;
-        auto  it2 = t.find(angle);
-        if (it2 == t.end()) {
+    void remove(uint8_t row, uint8_t angle) {
+        ObjectTypes type;
+        if (!exists(row, angle, type)) {
             return;
         }
-        del_obj(angle, it2->second);
-        t.erase(it2);
+        own_objects()[row].erase(angle);
+        del_obj(angle, type);
     }
 
     void read(std::istream& in, std::istream& lay);
-    void write(std::ostream& out, std::ostream& lay) const;
+    void write(
+            std::ostream& out, std::ostream& lay,
+            ObjectOrders order = eAngleOrder) const;
+    // Layout and objects in a single stream, layout byte first.
+    void read(std::istream& in) {
+        read(in, in);
+    }
+    void write(std::ostream& out) const {
+        write(out, out);
+    }
 };
 
 #endif    // SSSEGMENTOBJS_H
@@ -0,0 +1,143 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) Flamewing 2011-2019 <flamewing.sonic@gmail.com>
+ *
+ * S2-SSEdit is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * S2-SSEdit is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STAGEBITMAP_H
+#define STAGEBITMAP_H
+
+#include "s2ssedit/objectset.hh"
+
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+// One bit per (global row, angle) cell of a special stage: 256 angles, so
+// four 64-bit words per row. Objects map to global row segment * 64 + row;
+// segments never have more than 64 rows, so this does not depend on the
+// lengths of the segments. Only the rows from the first to the last set cell
+// are stored, so rebuilding the bitmap of a small set is cheap no matter
+// where in the stage it lies.
+class stage_bitmap {
+private:
+    static constexpr const size_t rows_per_segment = 0x40;
+    static constexpr const size_t words_per_row    = 4;
+    static constexpr const size_t bits_per_word    = 64;
+
+    std::vector<uint64_t> words;
+    size_t                first_row = 0;
+    size_t                rows      = 0;
+
+    size_t word_index(size_t row, uint8_t angle) const noexcept {
+        return (row - first_row) * words_per_row + angle / bits_per_word;
+    }
+    static uint64_t bit_mask(uint8_t angle) noexcept {
+        return uint64_t(1) << (angle % bits_per_word);
+    }
+    bool contains(size_t row) const noexcept {
+        return row >= first_row && row - first_row < rows;
+    }
+    // Extends the stored rows to include row.
+    void grow(size_t row) {
+        if (rows == 0) {
+            first_row = row;
+            rows      = 1;
+            words.assign(words_per_row, 0);
+        } else if (row < first_row) {
+            size_t extra = first_row - row;
+            words.insert(words.begin(), extra * words_per_row, 0);
+            first_row = row;
+            rows += extra;
+        } else if (row - first_row >= rows) {
+            rows = row - first_row + 1;
+            words.resize(rows * words_per_row, 0);
+        }
+    }
+    // Clears every bit and sets the rows stored to row0..row1 inclusive.
+    void reset_rows(size_t row0, size_t row1) {
+        first_row = row0;
+        rows      = row1 + 1 - row0;
+        words.assign(rows * words_per_row, 0);
+    }
+
+public:
+    stage_bitmap() noexcept = default;
+    explicit stage_bitmap(object_set const& objs) {
+        assign(objs);
+    }
+
+    static size_t global_row(int seg, int row) noexcept {
+        return size_t(seg) * rows_per_segment
+               + size_t(row) % rows_per_segment;
+    }
+    static size_t global_row(object const& obj) noexcept {
+        return global_row(obj.get_segment(), obj.get_pos());
+    }
+    static uint8_t angle_of(object const& obj) noexcept {
+        return static_cast<uint8_t>(obj.get_angle());
+    }
+
+    void clear() noexcept {
+        words.clear();
+        first_row = 0;
+        rows      = 0;
+    }
+
+    bool test(size_t row, uint8_t angle) const noexcept {
+        return contains(row)
+               && (words[word_index(row, angle)] & bit_mask(angle)) != 0;
+    }
+    void set(size_t row, uint8_t angle) {
+        grow(row);
+        words[word_index(row, angle)] |= bit_mask(angle);
+    }
+    void reset(size_t row, uint8_t angle) noexcept {
+        if (contains(row)) {
+            words[word_index(row, angle)] &= ~bit_mask(angle);
+        }
+    }
+
+    bool test(object const& obj) const noexcept {
+        return obj.valid() && test(global_row(obj), angle_of(obj));
+    }
+    void set(object const& obj) {
+        if (obj.valid()) {
+            set(global_row(obj), angle_of(obj));
+        }
+    }
+    void reset(object const& obj) noexcept {
+        if (obj.valid()) {
+            reset(global_row(obj), angle_of(obj));
+        }
+    }
+    // Replaces the contents with the positions of the objects. Sets are
+    // ordered by segment and row, with invalid objects last, so only the
+    // rows between the first and the last valid object are cleared.
+    void assign(object_set const& objs) {
+        // A default object is invalid, so this finds the first invalid one.
+        auto end = objs.lower_bound(object());
+        if (end == objs.begin()) {
+            clear();
+            return;
+        }
+        reset_rows(global_row(*objs.begin()), global_row(*std::prev(end)));
+        for (auto it = objs.begin(); it != end; ++it) {
+            set(*it);
+        }
+    }
+};
+
+#endif    // STAGEBITMAP_H
@@ -0,0 +1,95 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) Flamewing 2011-2019 <flamewing.sonic@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STAGESTATS_H
+#define STAGESTATS_H
+
+#include "s2ssedit/sslevelobjs.hh"
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+// Running totals of the objects in a stage, by segment, for tuning the ring
+// requirements. They are kept in a Fenwick tree, so changing the totals of
+// a segment and summing any run of segments both take O(log n).
+class stage_stats {
+public:
+    struct totals {
+        unsigned rings   = 0;
+        unsigned bombs   = 0;
+        unsigned shadows = 0;
+
+        totals& operator+=(totals const& other) noexcept {
+            rings += other.rings;
+            bombs += other.bombs;
+            shadows += other.shadows;
+            return *this;
+        }
+        totals& operator-=(totals const& other) noexcept {
+            rings -= other.rings;
+            bombs -= other.bombs;
+            shadows -= other.shadows;
+            return *this;
+        }
+    };
+    // A run of segments ending with a checkpoint or chaos emerald, or with
+    // the last segment of the stage; both ends are included.
+    struct interval {
+        size_t                   first;
+        size_t                   last;
+        sssegments::SegmentTypes end;
+        totals                   sum;
+    };
+
+private:
+    std::vector<totals>   tree;
+    std::vector<totals>   values;
+    std::vector<uint64_t> revisions;
+    // Segments that end an interval, and how.
+    std::map<size_t, sssegments::SegmentTypes> ends;
+
+    void add(size_t seg, totals const& delta) noexcept;
+    void rebuild(sslevels const& stage);
+
+public:
+    // Brings the totals up to date with the stage, and returns true if they
+    // changed. Changed segments are found by their revision; a full rebuild
+    // is only needed when segments were added or removed.
+    bool update(sslevels const& stage);
+
+    size_t size() const noexcept {
+        return values.size();
+    }
+    // Totals of the first count segments.
+    totals prefix(size_t count) const noexcept;
+    // Totals of segments first to last, inclusive.
+    totals range(size_t first, size_t last) const noexcept {
+        totals sum = prefix(last + 1);
+        sum -= prefix(first);
+        return sum;
+    }
+    totals stage_totals() const noexcept {
+        return prefix(values.size());
+    }
+    // The interval a segment of the stage is in, and its number.
+    interval get_interval(size_t seg, size_t& number) const;
+    std::vector<interval> get_intervals() const;
+};
+
+#endif    // STAGESTATS_H
@@ -0,0 +1,87 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) Flamewing 2011-2019 <flamewing.sonic@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STAGEVALIDATOR_H
+#define STAGEVALIDATOR_H
+
+#include "s2ssedit/ssobjfile.hh"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// A problem found by the validator. Problems with a whole segment have no
+// row, and problems with a whole stage have no segment either.
+struct validation_issue {
+    enum Kinds : uint8_t {
+        eTooManyObjects = 0,
+        eBadRow,
+        eBadGeometry,
+        eNoCheckpoint,
+        eNoEmerald,
+        eUnreachable
+    };
+    static constexpr const int none = -1;
+
+    Kinds                   kind    = eTooManyObjects;
+    unsigned                stage   = 0;
+    int                     segment = none;
+    int                     row     = none;
+    uint8_t                 angle   = 0;
+    sssegments::ObjectTypes type    = sssegments::eRing;
+    // Objects in the segment, segments that can't be reached, or the
+    // unknown geometry, depending on the kind.
+    unsigned value = 0;
+
+    std::string describe() const;
+    bool        operator==(validation_issue const& other) const noexcept;
+    bool        operator!=(validation_issue const& other) const noexcept {
+        return !(*this == other);
+    }
+};
+
+// Checks all stages of a project for problems the game can't cope with. The
+// checks of each segment are cached by segment revision, so a new run only
+// scans the segments changed since the last one; the checks of each stage
+// only look at the segment types.
+class stage_validator {
+public:
+    // Most objects the game can safely show in one segment.
+    static constexpr const uint16_t max_safe_num_objs = 100;
+
+private:
+    using issue_list = std::vector<validation_issue>;
+    // Issues of each segment, without their location.
+    std::unordered_map<uint64_t, issue_list> cache;
+    issue_list                               issues;
+
+    static issue_list check_segment(sssegments const& seg);
+
+public:
+    // Validates the whole project; returns true if the issues changed.
+    bool run(ssobj_file const& file);
+    // Forgets all issues; returns true if there were any.
+    bool clear();
+
+    issue_list const& get_issues() const noexcept {
+        return issues;
+    }
+};
+
+#endif    // STAGEVALIDATOR_H
@@ -0,0 +1,33 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) Flamewing 2011-2019 <flamewing.sonic@gmail.com>
+ *
+ * S2-SSEdit is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * S2-SSEdit is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef THUMBNAILS_H
+#define THUMBNAILS_H
+
+#include <string>
+#include <vector>
+
+// Renders every stage of every project directory in 'dirs' into a PNG in
+// 'outdir', spreading the stages over all available cores. Returns the
+// number of stages or projects that failed.
+size_t render_thumbnails(
+        std::string const& outdir, std::vector<std::string> const& dirs,
+        double scale, std::string const& ringfile,
+        std::string const& bombfile);
+
+#endif    // THUMBNAILS_H
@@ -0,0 +1,140 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) Flamewing 2011-2019 <flamewing.sonic@gmail.com>
+ *
+ * S2-SSEdit is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * S2-SSEdit is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef UNDOHISTORY_H
+#define UNDOHISTORY_H
+
+#include "s2ssedit/abstractaction.hh"
+#include "s2ssedit/actionarena.hh"
+#include "s2ssedit/editjournal.hh"
+
+#include <deque>
+#include <utility>
+
+// Undo and redo history with memory accounting. Actions live in an arena,
+// oldest first, followed by the actions that can be redone; each step of
+// the history covers one or more consecutive actions. When the history
+// goes over its byte or step budget, the oldest steps are dropped;
+// optionally, runs of small old steps are first compacted into one.
+class undo_history {
+public:
+    struct limits {
+        // Zero means unlimited.
+        size_t max_bytes = 0;
+        size_t max_steps = 0;
+        // Merge runs of small steps older than the most recent ones
+        // instead of dropping them while possible.
+        bool compact = false;
+    };
+
+    // Steps up to this size are candidates for compaction.
+    static constexpr const size_t small_action = 1024;
+    // Number of recent steps that are never compacted.
+    static constexpr const size_t keep_recent = 32;
+    // Largest number of actions compacted into a single step.
+    static constexpr const size_t max_group = 64;
+
+private:
+    struct step {
+        size_t count;    // Number of actions.
+        size_t bytes;
+    };
+
+    action_arena     actions;
+    std::deque<step> steps;               // Oldest first.
+    size_t           undo_count   = 0;    // Steps that can be undone.
+    size_t           undo_actions = 0;    // Actions in those steps.
+    size_t           undo_bytes = 0, redo_bytes = 0;
+    limits           budget;
+    edit_journal*    journal = nullptr;
+    // Nesting depth of the open transaction, and actions applied in it.
+    size_t transaction_depth = 0;
+    size_t queued            = 0;
+
+    static size_t record_size(action_arena::record& rec) noexcept;
+    bool over_budget() const noexcept;
+    void discard_redo() noexcept;
+    void add_newest();
+    void compact();
+    void enforce_limits();
+
+public:
+    limits const& get_limits() const noexcept {
+        return budget;
+    }
+    void set_limits(limits const& lim);
+    // Journal where applied and reverted actions are logged, if any.
+    void set_journal(edit_journal* jnl) noexcept {
+        journal = jnl;
+    }
+
+    // Constructs an action, applies it and records it, merging it into the
+    // newest step when possible. Clears the redo steps. Inside a
+    // transaction, the action is applied but not merged, and becomes part
+    // of the step the transaction commits.
+    template <typename Act, typename... Args>
+    void apply(ssobj_file_shared const& ss, object_set* sel, Args&&... args) {
+        if (transaction_depth == 0) {
+            discard_redo();
+        }
+        action_arena::record& rec
+                = actions.emplace_back<Act>(std::forward<Args>(args)...);
+        static_cast<Act*>(rec.get())->apply(ss, sel);
+        if (journal != nullptr) {
+            journal->append(edit_journal::eApply, rec);
+        }
+        if (transaction_depth != 0) {
+            queued++;
+            return;
+        }
+        add_newest();
+    }
+    // Transactions group the actions applied until the matching commit into
+    // a single step, made when the outermost transaction commits. Each
+    // action is applied as it comes, so it sees the effects of the earlier
+    // ones. Undo and redo do nothing while a transaction is open.
+    void begin() noexcept;
+    void commit();
+    bool in_transaction() const noexcept {
+        return transaction_depth != 0;
+    }
+
+    // Reverts the newest step and moves it to the redo steps, and vice
+    // versa. Return false if there was nothing to undo or redo.
+    bool undo(ssobj_file_shared const& ss, object_set* sel);
+    bool redo(ssobj_file_shared const& ss, object_set* sel);
+    void clear() noexcept;
+
+    bool can_undo() const noexcept {
+        return undo_count != 0;
+    }
+    bool can_redo() const noexcept {
+        return undo_count != steps.size();
+    }
+    size_t undo_steps() const noexcept {
+        return undo_count;
+    }
+    size_t redo_steps() const noexcept {
+        return steps.size() - undo_count;
+    }
+    size_t memory_usage() const noexcept {
+        return undo_bytes + redo_bytes;
+    }
+};
+
+#endif    // UNDOHISTORY_H
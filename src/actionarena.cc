@@ -0,0 +1,86 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) Flamewing 2011-2019 <flamewing.sonic@gmail.com>
+ *
+ * S2-SSEdit is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * S2-SSEdit is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "s2ssedit/actionarena.hh"
+
+#include <utility>
+
+using std::move;
+
+unsigned char* action_arena::allocate(size_t size) {
+    if (blocks.empty() || blocks.back().capacity - blocks.back().last < size) {
+        if (spare.data && spare.capacity >= size) {
+            blocks.push_back(move(spare));
+            spare = block{nullptr, 0, 0, 0};
+        } else {
+            size_t const capacity = size > block_size ? size : block_size;
+            blocks.push_back(block{
+                    std::unique_ptr<unsigned char[]>(
+                            new unsigned char[capacity]),
+                    capacity, 0, 0});
+            reserved += capacity;
+        }
+    }
+    block& blk = blocks.back();
+    return blk.data.get() + blk.last;
+}
+
+void action_arena::release(block& blk) noexcept {
+    blk.first = blk.last = 0;
+    if (spare.data) {
+        reserved -= spare.capacity;
+    }
+    spare = move(blk);
+}
+
+void action_arena::drop_empty_block() noexcept {
+    if (!blocks.empty() && blocks.back().first == blocks.back().last) {
+        release(blocks.back());
+        blocks.pop_back();
+    }
+}
+
+void action_arena::pop_back() noexcept {
+    record* rec = records.back();
+    records.pop_back();
+    destroy_action(rec->tag, rec->get());
+    block& blk = blocks.back();
+    blk.last -= rec->size;
+    if (blk.first == blk.last) {
+        release(blk);
+        blocks.pop_back();
+    }
+}
+
+void action_arena::pop_front() noexcept {
+    record* rec = records.front();
+    records.pop_front();
+    destroy_action(rec->tag, rec->get());
+    block& blk = blocks.front();
+    blk.first += rec->size;
+    if (blk.first == blk.last) {
+        release(blk);
+        blocks.pop_front();
+    }
+}
+
+void action_arena::clear() noexcept {
+    while (!records.empty()) {
+        pop_back();
+    }
+}
@@ -0,0 +1,173 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) Flamewing 2011-2019 <flamewing.sonic@gmail.com>
+ *
+ * S2-SSEdit is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * S2-SSEdit is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "s2ssedit/ignore_unused_variable_warning.hh"
+#include "s2ssedit/sseditor.hh"
+
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+void sseditor::copy_selection() {
+    int const origin = get_scroll();
+    copyrows.clear();
+    copyrows.reserve(selection.size());
+    for (auto const& elem : selection) {
+        copyrows.push_back(object_payload::object_row{
+                get_obj_pos<int>(elem) - origin,
+                static_cast<uint8_t>(elem.get_angle()), elem.get_type()});
+    }
+    publish_clipboard(object_payload::eObjectRows);
+}
+
+void sseditor::publish_clipboard(object_payload::Kinds kind) {
+    // The data is encoded in on_clipboard_get, if it is ever pasted.
+    vector<Gtk::TargetEntry> targets;
+    targets.emplace_back(
+            object_payload::target(kind), Gtk::TargetFlags(0), kind);
+    clipboard_owner = Gtk::Clipboard::get()->set(
+            targets, sigc::mem_fun(this, &sseditor::on_clipboard_get),
+            sigc::mem_fun(this, &sseditor::on_clipboard_clear));
+}
+
+bool sseditor::paste_from_clipboard(object_payload::Kinds kind) {
+    // Our own copies are pasted directly.
+    if (clipboard_owner || !clipboard_targets[kind]) {
+        return false;
+    }
+    Gtk::Clipboard::get()->request_contents(
+            object_payload::target(kind),
+            sigc::mem_fun(this, &sseditor::on_clipboard_received));
+    return true;
+}
+
+void sseditor::on_clipboard_get(
+        Gtk::SelectionData& selection_data, guint info) {
+    auto const kind = object_payload::Kinds(info);
+    switch (kind) {
+    case object_payload::eObjectRows:
+        selection_data.set(
+                object_payload::target(kind),
+                object_payload::encode(copyrows));
+        break;
+    case object_payload::eSegment:
+        if (copyseg) {
+            selection_data.set(
+                    object_payload::target(kind),
+                    object_payload::encode(*copyseg));
+        }
+        break;
+    case object_payload::eStage:
+        if (copylevel) {
+            selection_data.set(
+                    object_payload::target(kind),
+                    object_payload::encode(*copylevel));
+        }
+        break;
+    case object_payload::eObjects:
+    case object_payload::eNumKinds:
+        break;
+    }
+}
+
+void sseditor::on_clipboard_owner_change(GdkEventOwnerChange* event) {
+    ignore_unused_variable_warning(event);
+    Gtk::Clipboard::get()->request_targets(
+            sigc::mem_fun(this, &sseditor::on_clipboard_targets));
+}
+
+void sseditor::on_clipboard_targets(vector<Glib::ustring> const& targets) {
+    clipboard_targets.fill(false);
+    for (auto const& elem : targets) {
+        for (auto kind : {object_payload::eObjectRows, object_payload::eSegment,
+                          object_payload::eStage}) {
+            if (elem == object_payload::target(kind)) {
+                clipboard_targets[kind] = true;
+            }
+        }
+    }
+    update();
+}
+
+void sseditor::on_clipboard_received(Gtk::SelectionData const& selection_data) {
+    if (!specialstages || selection_data.get_length() <= 0) {
+        return;
+    }
+    // Decoded straight from the clipboard buffer.
+    void const*  data   = selection_data.get_data();
+    auto const   len    = size_t(selection_data.get_length());
+    string const target = selection_data.get_target();
+    if (target == SS_ROWS_TARGET) {
+        vector<object_payload::object_row> rows;
+        if (object_payload::decode(data, len, rows)) {
+            paste_objects(rows);
+        }
+    } else if (target == SS_SEGMENT_TARGET) {
+        sssegments sgm;
+        if (object_payload::decode(data, len, sgm)) {
+            paste_segment(sgm);
+        }
+    } else if (target == SS_STAGE_TARGET) {
+        sslevels lvl;
+        if (object_payload::decode(data, len, lvl)) {
+            paste_stage(lvl);
+        }
+    }
+}
+
+void sseditor::paste_objects(
+        vector<object_payload::object_row> const& rows) {
+    int const maxpos = endpos - 1;
+    int const origin = get_scroll();
+
+    vector<object> pasted;
+    pasted.reserve(rows.size());
+    for (auto const& elem : rows) {
+        int newpos = clamp(origin + elem.row, 0, maxpos);
+        int newseg = static_cast<int>(find_segment(newpos));
+        int newy   = newpos - segpos[newseg];
+        pasted.emplace_back(newseg, elem.angle, newy, elem.type);
+    }
+    selection = object_set(std::move(pasted));
+
+    do_action<paste_objects_action>(currstage, selection);
+    update();
+}
+
+void sseditor::paste_segment(sssegments const& sgm) {
+    do_action<paste_segment_action>(currstage, currsegment, sgm);
+    update_segment_positions(false);
+    if (currsegment >= segpos.size()) {
+        goto_segment(segpos.size() - 1);
+    }
+    update();
+}
+
+void sseditor::paste_stage(sslevels const& lvl) {
+    do_action<paste_stage_action>(++currstage, lvl);
+    if (currstage >= specialstages->num_stages()) {
+        currstage = specialstages->num_stages() - 1;
+    }
+    update_segment_positions(false);
+    if (currsegment >= segpos.size()) {
+        goto_segment(segpos.size() - 1);
+    }
+    update();
+}
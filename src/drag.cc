@@ -17,19 +17,14 @@
  */
 
 #include "s2ssedit/ignore_unused_variable_warning.hh"
+#include "s2ssedit/objectpayload.hh"
 #include "s2ssedit/sseditor.hh"
 
-#include <mdcomp/bigendian_io.hh>
-
-#include <set>
-#include <sstream>
+#include <cmath>
 #include <vector>
 
-using std::ios;
 using std::max;
 using std::min;
-using std::set;
-using std::stringstream;
 using std::tie;
 using std::tuple;
 using std::vector;
@@ -42,7 +37,7 @@ bool sseditor::on_specialstageobjs_configure_event(GdkEventConfigure* event) {
     if (!drop_enabled) {
         drop_enabled = true;
         vector<Gtk::TargetEntry> vec;
-        vec.emplace_back("SpecialStageObjects", Gtk::TargetFlags(0), 1);
+        vec.emplace_back(SS_OBJECTS_TARGET, Gtk::TargetFlags(0), 1);
         pspecialstageobjs->drag_dest_set(
                 vec, Gtk::DEST_DEFAULT_ALL, Gdk::ACTION_MOVE);
         pspecialstageobjs->signal_drag_data_received().connect(sigc::mem_fun(
@@ -196,17 +191,9 @@ bool sseditor::on_specialstageobjs_scroll_event(GdkEventScroll* event) {
     return true;
 }
 
-void sseditor::object_triangle(
-        int x, int y, int dx, int dy, int h, ObjectTypes type, bool fill,
-        set<object>& col) {
-    ignore_unused_variable_warning(col);
-    int numsegments = segpos.size();
-    int angle       = x;
-    int seg         = find_segment(y);
-    int pos         = y - segpos[seg];
-    if (seg < numsegments) {
-        insertstack.emplace(seg, angle_normal(angle), pos, type);
-    }
+void sseditor::shape_triangle(int y, int dx, int dy, int h, bool fill) {
+    auto& offsets = shape.offsets;
+    offsets.emplace_back(y, 0);
     int delta;
     int i;
     int last;
@@ -222,36 +209,26 @@ void sseditor::object_triangle(
         dy    = -dy;
     }
 
-    while (i < last) {
-        seg = find_segment(i);
-        pos = i - segpos[seg];
-        i += dy;
-        if (seg >= numsegments) {
-            continue;
-        }
-
-        int tx;
+    for (; i < last; i += dy) {
         if (fill) {
             int const cnt    = (2 * delta) / HALF_IMAGE_SIZE;
             int const middle = static_cast<int>((cnt % 2) == 0);
             int const dj     = 8 * delta;
             int const min    = middle != 0 ? cnt * SIMAGE_SIZE : 0;
             if (middle != 0) {
-                insertstack.emplace(seg, angle_normal(angle), pos, type);
+                offsets.emplace_back(i, 0);
             }
 
             for (int j = 4 * delta * cnt; j >= min; j -= dj) {
-                double jang = j / (4.0 * cnt);
-                tx          = angle_normal(static_cast<int8_t>(angle - jang));
-                insertstack.emplace(seg, tx, pos, type);
-                tx = angle_normal(static_cast<int8_t>(angle + jang));
-                insertstack.emplace(seg, tx, pos, type);
+                // Round outwards on the left and inwards on the right, as
+                // truncating angle -/+ jang did before the shape was cached.
+                double const jang = j / (4.0 * cnt);
+                offsets.emplace_back(i, -static_cast<int>(std::ceil(jang)));
+                offsets.emplace_back(i, static_cast<int>(std::floor(jang)));
             }
         } else {
-            tx = angle_normal(static_cast<int8_t>(angle - delta));
-            insertstack.emplace(seg, tx, pos, type);
-            tx = angle_normal(static_cast<int8_t>(angle + delta));
-            insertstack.emplace(seg, tx, pos, type);
+            offsets.emplace_back(i, -delta);
+            offsets.emplace_back(i, delta);
         }
         delta += dx;
     }
@@ -279,48 +256,48 @@ void sseditor::motion_update_selection(
             seg1, static_cast<int8_t>(angle1 + 0xc0), pos1 - segpos[seg1],
             sssegments::eRing);
     drawbox = true;
+    // Visit only the objects in the rows of the box instead of probing every
+    // cell; rows and angles both come out in order, so each object is
+    // appended at the end of the hotstack.
+    int const amin = min(angle0, angle1);
+    int const amax = max(angle0, angle1);
     for (int i = min(pos0, pos1); i <= max(pos0, pos1); i++) {
         int seg = find_segment(i);
         int pos = i - segpos[seg];
 
-        sssegments* currseg = get_segment(seg);
+        sssegments const* currseg = get_segment(seg);
         if (currseg == nullptr) {
             continue;
         }
-        for (int j = min(angle0, angle1); j <= max(angle0, angle1); j++) {
-            int         angle = static_cast<int8_t>(j + 0xc0);
-            ObjectTypes type;
-            if (currseg->exists(pos, angle, type)) {
-                hotstack.emplace(seg, angle, pos, type);
+        auto const& objects = currseg->get_objects();
+        auto        it      = objects.find(pos);
+        if (it == objects.end()) {
+            continue;
+        }
+        for (auto const& elem : it->second) {
+            // Box angles are offset so that the left edge of the tube is 0.
+            int j = (elem.first + 0x40) & 0xff;
+            if (j >= amin && j <= amax) {
+                hotstack.emplace(seg, elem.first, pos, elem.second);
             }
         }
     }
 }
 
-void sseditor::motion_update_line(
-        int dpos, int pos0, int pos1, int angle0, ObjectTypes type,
-        int angledelta) {
-    int const numsegments = segpos.size();
-    int const delta       = sigplus(dpos);
-    do {
-        int seg = find_segment(pos0);
-        int pos = pos0 - segpos[seg];
-        pos0 += delta;
-        if (seg < numsegments) {
-            insertstack.emplace(
-                    seg, angle_normal(static_cast<int8_t>(angle0)), pos, type);
-            angle0 = static_cast<int8_t>(angle0 + angledelta);
-        }
-    } while (pos0 != pos1 + delta);
+void sseditor::shape_line(int dpos, int angledelta) {
+    int const delta = sigplus(dpos);
+    int       angle = 0;
+    for (int ii = 0; ii != dpos + delta; ii += delta) {
+        shape.offsets.emplace_back(ii, angle);
+        angle += angledelta;
+    }
 }
 
 static inline int get_angle_delta(bool grid) {
     return grid ? 4 : 1;
 }
 
-void sseditor::motion_update_loop(
-        int dpos, int pos0, int angle0, ObjectTypes type, int angledelta,
-        bool grid) {
+void sseditor::shape_loop(int dpos, int angledelta, bool grid) {
     int    dy = signum(dpos);
     int    nobj;
     double delta;
@@ -340,80 +317,40 @@ void sseditor::motion_update_loop(
         delta = double(0x100 - angledelta) / nobj;
     }
 
-    int const numsegments = segpos.size();
-    for (int ii = 0; ii <= nobj; ii++, pos0 += dy) {
-        int seg = find_segment(pos0);
-        int pos = pos0 - segpos[seg];
-        if (seg < numsegments) {
-            insertstack.emplace(
-                    seg, angle_normal(static_cast<int8_t>(angle0)), pos, type);
-            angle0 += static_cast<int>(delta);
-        }
+    int angle = 0;
+    for (int ii = 0; ii <= nobj; ii++) {
+        shape.offsets.emplace_back(ii * dy, angle);
+        angle += static_cast<int>(delta);
     }
 }
 
-void sseditor::motion_update_zigzag(
-        int dpos, int pos0, int pos1, int angle0, ObjectTypes type,
-        int angledelta) {
+void sseditor::shape_zigzag(int dpos, int angledelta) {
     int const delta = sigplus(dpos);
+    int       angle = 0;
     angledelta      = clamp(angledelta, -HALF_IMAGE_SIZE, HALF_IMAGE_SIZE);
-    int const numsegments = segpos.size();
-    do {
-        int seg = find_segment(pos0);
-        int pos = pos0 - segpos[seg];
-        pos0 += delta;
-        if (seg < numsegments) {
-            insertstack.emplace(seg, angle_normal(angle0), pos, type);
-            angle0     = static_cast<int8_t>(angle0 + angledelta);
-            angledelta = -angledelta;
-        }
-    } while (pos0 != pos1 + delta);
+    for (int ii = 0; ii != dpos + delta; ii += delta) {
+        shape.offsets.emplace_back(ii, angle);
+        angle += angledelta;
+        angledelta = -angledelta;
+    }
 }
 
-void sseditor::motion_update_diamond(
-        int dpos, int pos0, int pos1, int angle0, ObjectTypes type,
-        int angledelta) {
-    int const delta       = sigplus(dpos);
-    int const numsegments = segpos.size();
+void sseditor::shape_diamond(int dpos, int angledelta) {
+    int const delta = sigplus(dpos);
     angledelta = clamp(abs(angledelta), QUARTER_IMAGE_SIZE, HALF_IMAGE_SIZE);
-    int angle  = angle0;
-    int ii     = pos0 + delta;
-    int seg    = find_segment(pos0);
-    int pos    = pos0 - segpos[seg];
-    if (seg < numsegments) {
-        insertstack.emplace(seg, angle_normal(angle), pos, type);
-    }
-    seg = find_segment(pos1);
-    pos = pos1 - segpos[seg];
-    if (seg < numsegments) {
-        insertstack.emplace(seg, angle_normal(angle), pos, type);
-    }
-    while (ii != pos1) {
-        seg = find_segment(ii);
-        pos = ii - segpos[seg];
-        ii += delta;
-        if (seg < numsegments) {
-            insertstack.emplace(
-                    seg, angle_normal(static_cast<int8_t>(angle - angledelta)),
-                    pos, type);
-            insertstack.emplace(
-                    seg, angle_normal(static_cast<int8_t>(angle + angledelta)),
-                    pos, type);
-        }
+    shape.offsets.emplace_back(0, 0);
+    shape.offsets.emplace_back(dpos, 0);
+    for (int ii = delta; ii != dpos; ii += delta) {
+        shape.offsets.emplace_back(ii, -angledelta);
+        shape.offsets.emplace_back(ii, angledelta);
     }
 }
 
-void sseditor::motion_update_star_lozenge(
-        int dpos, int pos0, int pos1, int angle0, ObjectTypes type,
-        int angledelta, bool fill) {
+void sseditor::shape_star_lozenge(int dpos, int angledelta, bool fill) {
     int off0 = static_cast<int>(dpos >= 0);
     int off1 = static_cast<int>(dpos < 0);
-    object_triangle(
-            angle0, pos0, angledelta, sigplus(dpos), (dpos + off0) / 2, type,
-            fill, insertstack);
-    object_triangle(
-            angle0, pos1, angledelta, -sigplus(dpos), (-dpos + off1) / 2, type,
-            fill, insertstack);
+    shape_triangle(0, angledelta, sigplus(dpos), (dpos + off0) / 2, fill);
+    shape_triangle(dpos, angledelta, -sigplus(dpos), (-dpos + off1) / 2, fill);
 }
 
 int sseditor::motion_compute_angledelta(
@@ -429,16 +366,103 @@ int sseditor::motion_compute_angledelta(
     return angledelta;
 }
 
+void sseditor::build_insert_shape(
+        InsertModes submode, int dpos, int angledelta) {
+    int const triangledelta
+            = clamp(abs(angledelta), QUARTER_IMAGE_SIZE, HALF_IMAGE_SIZE);
+    shape.offsets.clear();
+    switch (submode) {
+    case eLine:
+        shape_line(dpos, angledelta);
+        break;
+    case eLoop:
+        shape_loop(dpos, angledelta, shape.grid);
+        break;
+    case eZigzag:
+        shape_zigzag(dpos, angledelta);
+        break;
+    case eDiamond:
+        shape_diamond(dpos, angledelta);
+        break;
+    case eLozenge:
+    case eStar:
+        shape_star_lozenge(dpos, triangledelta, submode == eLozenge);
+        break;
+    case eTriangle:
+        shape_triangle(dpos, triangledelta, -sigplus(dpos), -dpos, true);
+        break;
+    case eSingle:
+    case ePattern:
+    case eNumInsertModes:
+        __builtin_unreachable();
+    }
+}
+
+void sseditor::place_insert_shape(int pos0, int angle0, ObjectTypes type) {
+    // Angle offsets are relative to the angle where the drag started, so they
+    // can be added to it as they are; the sum wraps around the tube.
+    int const origin = angle_normal(angle0);
+    insertstack.clear();
+    for (auto const& elem : shape.offsets) {
+        int const row = pos0 + elem.first;
+        if (row < 0 || row >= endpos) {
+            continue;
+        }
+        int const seg = find_segment(row);
+        insertstack.emplace(
+                seg, (origin + elem.second) & 0xff, row - segpos[seg], type);
+    }
+    shape.type     = type;
+    shape.pos0     = pos0;
+    shape.angle0   = angle0;
+    shape.revision = insertstack.get_revision();
+}
+
+void sseditor::place_pattern(int pos1, int angle1, ObjectTypes type) {
+    if (shape.submode == ePattern && shape.pattern == current_pattern
+        && shape.type == type && shape.pos0 == pos1 && shape.angle0 == angle1
+        && shape.revision == insertstack.get_revision()) {
+        return;
+    }
+    // The cells are stamped into a list and sorted once, instead of being
+    // inserted into the set one at a time.
+    insert_pattern const& pat    = patterns[current_pattern];
+    int const             origin = angle_normal(angle1);
+    std::vector<object>   objs;
+    objs.reserve(pat.cells.size());
+    for (auto const& elem : pat.cells) {
+        int const row = pos1 + elem.row;
+        if (row < 0 || row >= endpos) {
+            continue;
+        }
+        int const seg = find_segment(row);
+        objs.emplace_back(
+                seg, (origin + elem.angle) & 0xff, row - segpos[seg],
+                pat.get_type(elem, type));
+    }
+    insertstack    = object_set(std::move(objs));
+    shape.submode  = ePattern;
+    shape.pattern  = current_pattern;
+    shape.type     = type;
+    shape.pos0     = pos1;
+    shape.angle0   = angle1;
+    shape.revision = insertstack.get_revision();
+}
+
 void sseditor::motion_update_insertion(
         int dangle, int dpos, int pos0, int pos1, int angle0, int angle1,
         bool grid, bool lbutton_pressed) {
-    insertstack.clear();
     ObjectTypes type;
     InsertModes submode;
     tie(type, submode) = get_obj_type();
 
-    if (submode == eSingle || (submode != eLoop && dpos == 0)
-        || !lbutton_pressed) {
+    if (submode == ePattern && current_pattern < patterns.size()) {
+        place_pattern(pos1, angle1, type);
+        return;
+    }
+    if (submode == eSingle || submode == ePattern
+        || (submode != eLoop && dpos == 0) || !lbutton_pressed) {
+        insertstack.clear();
         int seg1 = find_segment(pos1);
         insertstack.emplace(
                 seg1, angle_normal(angle1), pos1 - segpos[seg1], type);
@@ -448,37 +472,22 @@ void sseditor::motion_update_insertion(
     const int angledelta
             = motion_compute_angledelta(dpos, submode, grid, dangle);
 
-    switch (submode) {
-    case eLine:
-        motion_update_line(dpos, pos0, pos1, angle0, type, angledelta);
-        break;
-    case eLoop:
-        motion_update_loop(dpos, pos0, angle0, type, angledelta, grid);
-        break;
-    case eZigzag:
-        motion_update_zigzag(dpos, pos0, pos1, angle0, type, angledelta);
-        break;
-    case eDiamond:
-        motion_update_diamond(dpos, pos0, pos1, angle0, type, angledelta);
-        break;
-    case eLozenge:
-    case eStar: {
-        motion_update_star_lozenge(
-                dpos, pos0, pos1, angle0, type,
-                clamp(abs(angledelta), QUARTER_IMAGE_SIZE, HALF_IMAGE_SIZE),
-                submode == eLozenge);
-        break;
+    bool const same_shape = shape.submode == submode && shape.dpos == dpos
+                            && shape.angledelta == angledelta
+                            && shape.grid == grid;
+    if (same_shape && shape.type == type && shape.pos0 == pos0
+        && shape.angle0 == angle0
+        && shape.revision == insertstack.get_revision()) {
+        return;
     }
-    case eTriangle:
-        object_triangle(
-                angle0, pos1,
-                clamp(abs(angledelta), QUARTER_IMAGE_SIZE, HALF_IMAGE_SIZE),
-                -sigplus(dpos), -dpos, type, true, insertstack);
-        break;
-    case eSingle:
-    case eNumInsertModes:
-        __builtin_unreachable();
+    if (!same_shape) {
+        shape.submode    = submode;
+        shape.dpos       = dpos;
+        shape.angledelta = angledelta;
+        shape.grid       = grid;
+        build_insert_shape(submode, dpos, angledelta);
     }
+    place_insert_shape(pos0, angle0, type);
 }
 
 void sseditor::motion_update_select_insert(GdkEventMotion* event) {
@@ -522,8 +531,7 @@ bool sseditor::on_specialstageobjs_motion_notify_event(GdkEventMotion* event) {
     }
 
     bool lbutton_pressed = (event->state & GDK_BUTTON1_MASK) != 0;
-    bool isdragging
-            = hotspot.valid() && selection.find(hotspot) != selection.end();
+    bool isdragging = hotspot.valid() && is_selected(hotspot);
 
     state   = event->state;
     mouse_x = event->x;
@@ -542,7 +550,7 @@ bool sseditor::on_specialstageobjs_motion_notify_event(GdkEventMotion* event) {
 
     dragging = true;
     vector<Gtk::TargetEntry> vec;
-    vec.emplace_back("SpecialStageObjects", Gtk::TargetFlags(0), 1);
+    vec.emplace_back(SS_OBJECTS_TARGET, Gtk::TargetFlags(0), 1);
     Glib::RefPtr<Gtk::TargetList> lst = Gtk::TargetList::create(vec);
     pspecialstageobjs->drag_begin(
             lst, Gdk::ACTION_MOVE, 1, reinterpret_cast<GdkEvent*>(event));
@@ -559,6 +567,18 @@ void sseditor::on_specialstageobjs_drag_begin(
     sourcestack = selection;
 }
 
+object sseditor::drag_target(object obj) const {
+    if (drag_dangle == 0 && drag_dpos == 0) {
+        return obj;
+    }
+    obj.set_angle(static_cast<int8_t>(obj.get_angle() + drag_dangle));
+    int pos = clamp(get_obj_pos<int>(obj) + drag_dpos, 0, endpos - 1);
+    int seg = find_segment(pos);
+    obj.set_pos(pos - segpos[seg]);
+    obj.set_segment(seg);
+    return obj;
+}
+
 bool sseditor::on_drag_motion(
         Glib::RefPtr<Gdk::DragContext> const& context, int x, int y,
         guint time) {
@@ -579,22 +599,16 @@ bool sseditor::on_drag_motion(
         dangle = x_to_angle(x, snaptogrid);
         dpos   = y / SIMAGE_SIZE + get_scroll();
     }
-    dangle = static_cast<int8_t>(dangle - lastclick.get_angle());
-    dpos -= get_obj_pos<int>(lastclick);
+    drag_dangle = static_cast<int8_t>(dangle - lastclick.get_angle());
+    drag_dpos   = dpos - get_obj_pos<int>(lastclick);
 
     insertstack.clear();
 
-    if (dangle == 0 && dpos == 0) {
+    if (drag_dangle == 0 && drag_dpos == 0) {
         insertstack = sourcestack;
     } else {
-        int maxpos = endpos - 1;
-        for (auto obj : sourcestack) {
-            obj.set_angle(static_cast<int8_t>(obj.get_angle() + dangle));
-            int pos = clamp(get_obj_pos<int>(obj) + dpos, 0, maxpos);
-            int seg = find_segment(pos);
-            obj.set_pos(pos - segpos[seg]);
-            obj.set_segment(seg);
-            insertstack.insert(obj);
+        for (auto const& obj : sourcestack) {
+            insertstack.insert(drag_target(obj));
         }
     }
 
@@ -612,14 +626,7 @@ void sseditor::on_specialstageobjs_drag_data_get(
         return;
     }
 
-    stringstream data(ios::in | ios::out | ios::binary);
-    for (auto const& elem : insertstack) {
-        Write1(data, elem.get_segment());
-        Write1(data, elem.get_angle());
-        Write1(data, elem.get_pos());
-        Write1(data, uint8_t(elem.get_type()));
-    }
-    selection_data.set("SpecialStageObjects", data.str());
+    selection_data.set(SS_OBJECTS_TARGET, object_payload::encode(insertstack));
 }
 
 void sseditor::on_specialstageobjs_drag_end(
@@ -632,28 +639,36 @@ void sseditor::on_specialstageobjs_drag_data_received(
         Glib::RefPtr<Gdk::DragContext> const& context, int x, int y,
         Gtk::SelectionData const& selection_data, guint info, guint time) {
     ignore_unused_variable_warning(x, y, info);
-    if (selection_data.get_data_type() == "SpecialStageObjects"
-        && selection_data.get_length() > 0) {
-        // set<object> temp = sourcestack;
+    object_set dropped;
+    if (selection_data.get_data_type() == SS_OBJECTS_TARGET
+        && selection_data.get_length() > 0
+        && object_payload::decode(
+                selection_data.get_data(),
+                size_t(selection_data.get_length()), dropped)
+        && (dropped.empty()
+            || size_t((--dropped.end())->get_segment()) < segpos.size())) {
         context->drag_finish(true, false, time);
-
-        size_t        len  = selection_data.get_length();
-        guchar const* data = selection_data.get_data();
-        guchar const* ptr  = data;
-        selection.clear();
-
-        while (len > 0) {
-            int  newseg   = Read1(ptr);
-            int  newangle = Read1(ptr);
-            int  newpos   = Read1(ptr);
-            auto newtype  = ObjectTypes(Read1(ptr));
-            len -= 4;
-            selection.emplace(newseg, newangle, newpos, newtype);
-        }
+        selection.swap(dropped);
 
         if (!equal(sourcestack.begin(), sourcestack.end(), selection.begin(),
-                   ObjectMatchFunctor())) {
-            do_action<move_objects_action>(currstage, sourcestack, selection);
+                   selection.end(), ObjectMatchFunctor())) {
+            // Dropped objects lose track of where they came from; if they
+            // match the drag in progress, store the move as an offset.
+            std::vector<object> dests;
+            dests.reserve(sourcestack.size());
+            for (auto const& elem : sourcestack) {
+                dests.push_back(drag_target(elem));
+            }
+            object_set const targets(dests);
+            if (targets.size() == selection.size()
+                && equal(targets.begin(), targets.end(), selection.begin(),
+                         ObjectMatchFunctor())) {
+                do_action<shift_objects_action>(
+                        currstage, sourcestack, dests);
+            } else {
+                do_action<move_objects_action>(
+                        currstage, sourcestack, selection);
+            }
         }
         sourcestack.clear();
     } else {
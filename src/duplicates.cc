@@ -0,0 +1,146 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) Flamewing 2011-2019 <flamewing.sonic@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "s2ssedit/sseditor.hh"
+
+#include <array>
+#include <string>
+
+using std::array;
+using std::string;
+using std::to_string;
+
+namespace {
+    struct duplicate_columns : Gtk::TreeModelColumnRecord {
+        Gtk::TreeModelColumn<Glib::ustring> where;
+        Gtk::TreeModelColumn<unsigned>      copies;
+        Gtk::TreeModelColumn<unsigned>      bytes;
+        duplicate_columns() {
+            add(where);
+            add(copies);
+            add(bytes);
+        }
+    };
+
+    char const* order_name(sssegments::ObjectOrders order) noexcept {
+        switch (order) {
+        case sssegments::eAngleOrder:
+        case sssegments::eNumObjectOrders:
+            break;
+        case sssegments::eReverseAngleOrder:
+            return "angles reversed";
+        case sssegments::eRingsFirstOrder:
+            return "rings first";
+        }
+        return "by angle";
+    }
+
+    string where(segment_index::duplicate_group const& group) {
+        string text;
+        for (auto const& elem : group.copies) {
+            text += text.empty() ? "Stage " : "; stage ";
+            text += to_string(elem.stage + 1) + ", segment "
+                    + to_string(elem.segment + 1);
+        }
+        return text;
+    }
+}    // namespace
+
+void sseditor::on_duplicatesbutton_clicked() {
+    if (!specialstages) {
+        return;
+    }
+    duplicates.update(*specialstages);
+
+    // The object file as it is on disk, and as it would be saved with each
+    // order of the objects in a row.
+    using ObjectOrders         = sssegments::ObjectOrders;
+    size_t const       stored  = specialstages->stored_size();
+    ObjectOrders const current = specialstages->get_object_order();
+    ObjectOrders       best    = current;
+
+    array<size_t, sssegments::eNumObjectOrders> packed{};
+    for (size_t ii = 0; ii < packed.size(); ii++) {
+        auto const order = ObjectOrders(ii);
+        packed[ii]       = specialstages->compressed_size(order);
+        if (packed[ii] < packed[best]) {
+            best = order;
+        }
+    }
+
+    Gtk::Dialog dialog("Duplicate segments", *main_win, true);
+    dialog.add_button("_Close", Gtk::RESPONSE_CLOSE);
+    dialog.add_button("C_ompact", Gtk::RESPONSE_APPLY);
+    dialog.set_default_response(Gtk::RESPONSE_CLOSE);
+    dialog.set_response_sensitive(Gtk::RESPONSE_APPLY, best != current);
+
+    size_t copies = 0;
+    for (auto const& elem : duplicates.get_duplicates()) {
+        copies += elem.copies.size() - 1;
+    }
+    string text = to_string(copies)
+                  + " segments are copies of others, and take "
+                  + to_string(duplicates.wasted_bytes()) + " of the "
+                  + to_string(specialstages->size())
+                  + " bytes of the object file.\n\nCompressed object file:"
+                  + "\n    on disk: " + to_string(stored) + " bytes";
+    for (size_t ii = 0; ii < packed.size(); ii++) {
+        auto const order = ObjectOrders(ii);
+        text += "\n    saved " + string(order_name(order)) + ": "
+                + to_string(packed[ii]) + " bytes";
+        if (order == current) {
+            text += " (in use)";
+        }
+    }
+    if (best != current) {
+        text += "\n\nCompact saves objects " + string(order_name(best))
+                + " from now on, which saves "
+                + to_string(packed[current] - packed[best]) + " bytes.";
+    }
+    Gtk::Label summary(text);
+    summary.set_halign(Gtk::ALIGN_START);
+    summary.set_line_wrap(true);
+    summary.set_selectable(true);
+
+    duplicate_columns            cols;
+    Glib::RefPtr<Gtk::ListStore> store = Gtk::ListStore::create(cols);
+    for (auto const& elem : duplicates.get_duplicates()) {
+        Gtk::TreeRow row = *store->append();
+        row[cols.where]  = where(elem);
+        row[cols.copies] = unsigned(elem.copies.size());
+        row[cols.bytes]  = unsigned(elem.size);
+    }
+    Gtk::TreeView view;
+    view.set_model(store);
+    view.append_column("Segments", cols.where);
+    view.append_column("Copies", cols.copies);
+    view.append_column("Bytes", cols.bytes);
+    Gtk::ScrolledWindow scroll;
+    scroll.set_policy(Gtk::POLICY_AUTOMATIC, Gtk::POLICY_AUTOMATIC);
+    scroll.set_size_request(480, 240);
+    scroll.add(view);
+
+    Gtk::Box* box = dialog.get_content_area();
+    box->set_border_width(8);
+    box->pack_start(summary, false, false, 4);
+    box->pack_start(scroll, true, true, 4);
+    dialog.show_all();
+    if (dialog.run() == Gtk::RESPONSE_APPLY) {
+        specialstages->set_object_order(best);
+    }
+}
@@ -0,0 +1,281 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) Flamewing 2011-2019 <flamewing.sonic@gmail.com>
+ *
+ * S2-SSEdit is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * S2-SSEdit is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "s2ssedit/editjournal.hh"
+
+#include "s2ssedit/ssobjfile.hh"
+
+#include <mdcomp/bigendian_io.hh>
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+#ifdef _WIN32
+#    include <io.h>
+#    define fileno _fileno
+#    define fsync _commit
+#else
+#    include <unistd.h>
+#endif
+
+using std::ifstream;
+using std::ios;
+using std::istringstream;
+using std::ostringstream;
+using std::string;
+
+namespace {
+    constexpr const char    magic[]      = "S2SSJRNL";
+    constexpr const size_t  magic_size   = sizeof(magic) - 1;
+    constexpr const uint8_t version      = 1;
+    constexpr const size_t  header_size  = magic_size + 1 + 8;
+    constexpr const size_t  record_start = 1 + 1 + 4;
+
+    string journal_path(string const& dir) {
+        return dir + SS_JOURNAL_FILE;
+    }
+
+    bool write_out(std::FILE* file, string const& data) noexcept {
+        return std::fwrite(data.data(), 1, data.size(), file) == data.size()
+               && std::fflush(file) == 0;
+    }
+
+    // FNV-1a of the saved project files, so that a journal is never
+    // replayed onto anything but the files it was made from.
+    uint64_t project_hash(string const& dir) {
+        constexpr const uint64_t basis = 0xcbf29ce484222325ULL;
+        constexpr const uint64_t prime = 0x100000001b3ULL;
+
+        uint64_t hash = basis;
+        for (auto const& name :
+             {dir + SS_OBJECT_FILE, dir + SS_LAYOUT_FILE}) {
+            ifstream in(name, ios::in | ios::binary);
+            char     buffer[4096];
+            while (in.read(buffer, sizeof(buffer)) || in.gcount() > 0) {
+                for (std::streamsize ii = 0; ii < in.gcount(); ii++) {
+                    hash ^= static_cast<unsigned char>(buffer[ii]);
+                    hash *= prime;
+                }
+            }
+        }
+        return hash;
+    }
+
+    // Reads the journal left in dir, if it was made for the project as
+    // currently saved.
+    bool load_journal(string const& dir, string& contents) {
+        ifstream in(journal_path(dir), ios::in | ios::binary);
+        contents.assign(
+                std::istreambuf_iterator<char>(in),
+                std::istreambuf_iterator<char>());
+        if (contents.size() < header_size
+            || contents.compare(0, magic_size, magic) != 0
+            || uint8_t(contents[magic_size]) != version) {
+            return false;
+        }
+        auto const* ptr = reinterpret_cast<unsigned char const*>(
+                contents.data() + magic_size + 1);
+        uint64_t hash = BigEndian::Read4(ptr);
+        hash = (hash << 32U) | BigEndian::Read4(ptr);
+        return hash == project_hash(dir);
+    }
+
+    // Calls func(op, tag, record) for each complete record, until it
+    // returns false; returns the number of records it accepted, and where
+    // the last one ends in end.
+    template <typename Func>
+    size_t for_each_record(string const& contents, Func func, size_t& end) {
+        auto const* data
+                = reinterpret_cast<unsigned char const*>(contents.data());
+        size_t pos   = header_size;
+        size_t count = 0;
+        while (contents.size() - pos >= record_start) {
+            unsigned const       op   = data[pos];
+            unsigned const       tag  = data[pos + 1];
+            unsigned char const* ptr  = data + pos + 2;
+            size_t const         size = BigEndian::Read4(ptr);
+            // A record cut short marks where the editor stopped.
+            if (contents.size() - pos - record_start < size
+                || op > edit_journal::eRevert
+                || !is_action_tag(tag)) {
+                break;
+            }
+            istringstream record(
+                    contents.substr(pos + record_start, size),
+                    ios::in | ios::binary);
+            if (!func(edit_journal::Operation(op), ActionTag(tag), record)) {
+                break;
+            }
+            pos += record_start + size;
+            count++;
+        }
+        end = pos;
+        return count;
+    }
+}    // namespace
+
+bool edit_journal::open(string const& dir, bool keep) {
+    close();
+    path = journal_path(dir);
+    // Keep the records that can be replayed, dropping any cut short.
+    string contents;
+    size_t kept = 0, end = 0;
+    if (keep && load_journal(dir, contents)) {
+        kept = for_each_record(
+                contents,
+                [](Operation op, ActionTag tag, std::istream& record) {
+                    ignore_unused_variable_warning(op, tag, record);
+                    return true;
+                },
+                end);
+    }
+    if (kept != 0) {
+        contents.resize(end);
+    } else {
+        ostringstream  header(ios::out | ios::binary);
+        uint64_t const hash = project_hash(dir);
+        header.write(magic, magic_size);
+        Write1(header, version);
+        BigEndian::Write4(header, uint32_t(hash >> 32U));
+        BigEndian::Write4(header, uint32_t(hash));
+        contents = header.str();
+    }
+    // The new journal is written to the side and renamed over the old one,
+    // so a crash leaves one or the other whole.
+    string const temp = path + ".tmp";
+    std::FILE*   out  = std::fopen(temp.c_str(), "wb");
+    bool         written = out != nullptr && write_out(out, contents)
+                           && fsync(fileno(out)) == 0;
+    if (out != nullptr && std::fclose(out) != 0) {
+        written = false;
+    }
+#ifdef _WIN32
+    // Renaming does not replace an existing file here.
+    if (written) {
+        std::remove(path.c_str());
+    }
+#endif
+    if (!written || std::rename(temp.c_str(), path.c_str()) != 0) {
+        std::remove(temp.c_str());
+        failed = true;
+        return false;
+    }
+    file = std::fopen(path.c_str(), "ab");
+    if (file == nullptr) {
+        failed = true;
+        return false;
+    }
+    records = kept;
+    return true;
+}
+
+void edit_journal::close() noexcept {
+    sync();
+    if (file == nullptr) {
+        return;
+    }
+    if (std::fclose(file) != 0) {
+        failed = true;
+    }
+    file = nullptr;
+    if (records == 0) {
+        std::remove(path.c_str());
+    }
+}
+
+void edit_journal::fail() noexcept {
+    std::fclose(file);
+    file = nullptr;
+    pending.clear();
+    unsynced = false;
+    failed   = true;
+}
+
+void edit_journal::append(Operation op, action_arena::record& rec) {
+    if (file == nullptr) {
+        return;
+    }
+    ostringstream payload(ios::out | ios::binary);
+    write_action(rec.tag, rec.get(), payload);
+    string const data = payload.str();
+
+    ostringstream header(ios::out | ios::binary);
+    Write1(header, op);
+    Write1(header, unsigned(rec.tag));
+    BigEndian::Write4(header, uint32_t(data.size()));
+    pending += header.str();
+    pending += data;
+    records++;
+    if (pending.size() >= batch_size) {
+        flush();
+    }
+}
+
+void edit_journal::flush() noexcept {
+    if (file == nullptr || pending.empty()) {
+        return;
+    }
+    if (!write_out(file, pending)) {
+        fail();
+        return;
+    }
+    pending.clear();
+    unsynced = true;
+}
+
+void edit_journal::sync() noexcept {
+    flush();
+    if (file != nullptr && unsynced) {
+        if (fsync(fileno(file)) != 0) {
+            fail();
+            return;
+        }
+        unsynced = false;
+    }
+}
+
+size_t edit_journal::pending_edits(string const& dir) {
+    string contents;
+    if (!load_journal(dir, contents)) {
+        return 0;
+    }
+    size_t end;
+    return for_each_record(
+            contents,
+            [](Operation op, ActionTag tag, std::istream& record) {
+                ignore_unused_variable_warning(op, tag, record);
+                return true;
+            },
+            end);
+}
+
+size_t edit_journal::replay(string const& dir, ssobj_file_shared const& ss) {
+    string contents;
+    if (!load_journal(dir, contents)) {
+        return 0;
+    }
+    size_t end;
+    return for_each_record(
+            contents,
+            [&ss](Operation op, ActionTag tag, std::istream& record) {
+                return replay_action(tag, record, ss, op == eRevert);
+            },
+            end);
+}
@@ -0,0 +1,189 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) Flamewing 2011-2019 <flamewing.sonic@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "s2ssedit/sseditor.hh"
+
+#include <limits>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+using std::map;
+using std::string;
+using std::to_string;
+using std::vector;
+
+// Copied objects as a formation anchored at the given stage row and angle,
+// which is where they would be pasted from the current view.
+static insert_pattern copied_formation(
+        vector<object_payload::object_row> const& rows, int origin, int row0,
+        uint8_t angle0) {
+    constexpr const int min_row = std::numeric_limits<int16_t>::min();
+    constexpr const int max_row = std::numeric_limits<int16_t>::max();
+    insert_pattern      pat;
+    pat.cells.reserve(rows.size());
+    for (auto const& elem : rows) {
+        int const row = origin + elem.row - row0;
+        if (row >= min_row && row <= max_row) {
+            pat.cells.push_back(insert_pattern::cell{
+                    static_cast<int16_t>(row),
+                    static_cast<uint8_t>(elem.angle - angle0), elem.type});
+        }
+    }
+    return pat;
+}
+
+void sseditor::on_findformationbutton_clicked() {
+    if (!specialstages || selection.empty()) {
+        return;
+    }
+    // Captured patterns start with the first selected object.
+    insert_pattern const pat
+            = pattern_library::capture("formation", selection, segpos);
+    if (pat.cells.empty()) {
+        return;
+    }
+    object const& anchor = *selection.begin();
+
+    Gtk::Dialog dialog("Find formation", *main_win, true);
+    dialog.add_button("_Cancel", Gtk::RESPONSE_CANCEL);
+    dialog.add_button("_Find", Gtk::RESPONSE_OK);
+    dialog.set_default_response(Gtk::RESPONSE_OK);
+
+    Gtk::Grid grid;
+    grid.set_row_spacing(4);
+    grid.set_column_spacing(8);
+    grid.set_border_width(8);
+
+    auto* label = Gtk::manage(new Gtk::Label("Search:"));
+    label->set_halign(Gtk::ALIGN_START);
+    grid.attach(*label, 0, 0, 1, 1);
+    Gtk::ComboBoxText scope;
+    scope.append("Current stage");
+    scope.append("All stages");
+    scope.set_active(formation_all_stages ? 1 : 0);
+    grid.attach(scope, 1, 0, 1, 1);
+
+    Gtk::CheckButton replace("Replace with the copied objects");
+    replace.set_tooltip_text(
+            "Each match is replaced by the copied objects, placed relative "
+            "to it as they would be pasted relative to the selection");
+    replace.set_sensitive(!copyrows.empty());
+    grid.attach(replace, 1, 1, 1, 1);
+
+    dialog.get_content_area()->pack_start(grid);
+    dialog.show_all();
+    if (dialog.run() != Gtk::RESPONSE_OK) {
+        return;
+    }
+    dialog.hide();
+
+    formation_all_stages = scope.get_active_row_number() == 1;
+    vector<formation_match> const matches
+            = formation_all_stages
+                      ? formation_search::find(pat, *specialstages)
+                      : formation_search::find(
+                              pat, *specialstages->get_stage(currstage),
+                              currstage);
+
+    if (replace.get_active() && !copyrows.empty()) {
+        replace_formation(
+                matches,
+                copied_formation(
+                        copyrows, get_scroll(), get_obj_pos<int>(anchor),
+                        static_cast<uint8_t>(anchor.get_angle())));
+        return;
+    }
+
+    // Matches of the current stage are selected; the others are counted.
+    vector<object>        found;
+    size_t                here = 0;
+    map<unsigned, size_t> elsewhere;
+    for (auto const& elem : matches) {
+        if (elem.stage != currstage) {
+            elsewhere[elem.stage]++;
+            continue;
+        }
+        here++;
+        found.insert(found.end(), elem.objects.begin(), elem.objects.end());
+    }
+    selection = object_set(std::move(found));
+    hotstack.clear();
+    update();
+
+    Gtk::MessageDialog info(
+            *main_win, to_string(here) + " matches in this stage.", false,
+            Gtk::MESSAGE_INFO);
+    if (formation_all_stages) {
+        string text;
+        for (auto const& elem : elsewhere) {
+            text += "Stage " + to_string(elem.first + 1) + ": "
+                    + to_string(elem.second) + " matches\n";
+        }
+        info.set_secondary_text(
+                text.empty() ? string("No matches in other stages.") : text);
+    }
+    info.run();
+}
+
+void sseditor::replace_formation(
+        vector<formation_match> const& matches, insert_pattern const& repl) {
+    // Matches come in stage order; all stages change in a single undo step.
+    size_t replaced = 0;
+    begin_edits();
+    for (auto it = matches.cbegin(); it != matches.cend();) {
+        unsigned const  stage   = it->stage;
+        sslevels const* currlvl = specialstages->get_stage(stage);
+        vector<object>  del;
+        vector<object>  add;
+        for (; it != matches.cend() && it->stage == stage; ++it) {
+            del.insert(del.end(), it->objects.begin(), it->objects.end());
+            object_set const placed = formation_search::place(
+                    repl, *currlvl, it->row, it->angle, sssegments::eRing);
+            add.insert(add.end(), placed.begin(), placed.end());
+            replaced++;
+        }
+        // Objects that the new ones overwrite come back on undo.
+        for (auto const& elem : add) {
+            sssegments const* currseg
+                    = currlvl->get_segment(size_t(elem.get_segment()));
+            ObjectTypes type;
+            if (currseg->exists(
+                        uint8_t(elem.get_pos()), uint8_t(elem.get_angle()),
+                        type)) {
+                del.emplace_back(
+                        elem.get_segment(), elem.get_angle(), elem.get_pos(),
+                        type);
+            }
+        }
+        object_set added(std::move(add));
+        if (stage == currstage) {
+            selection = added;
+        }
+        do_action<insert_objects_ex_action>(
+                int(stage), object_set(std::move(del)), added);
+    }
+    hotstack.clear();
+    commit_edits();
+
+    Gtk::MessageDialog info(
+            *main_win, "Replaced " + to_string(replaced) + " matches.", false,
+            Gtk::MESSAGE_INFO);
+    info.run();
+}
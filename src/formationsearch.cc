@@ -0,0 +1,189 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) Flamewing 2011-2019 <flamewing.sonic@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "s2ssedit/formationsearch.hh"
+
+#include <algorithm>
+#include <iterator>
+
+using std::vector;
+
+namespace {
+    // Cells of a stage: what is in each (row, angle), and whether a match
+    // has already taken it.
+    class stage_grid {
+    public:
+        enum Contents : uint8_t { eEmpty = 0, eRing, eBomb };
+
+    private:
+        vector<uint8_t> cells;
+        vector<bool>    taken;
+        vector<int>     segpos;
+        int             numrows;
+
+        size_t cell_index(int row, uint8_t angle) const noexcept {
+            return size_t(row) * 256U + angle;
+        }
+
+    public:
+        explicit stage_grid(sslevels const& stage)
+                : numrows(int(stage.fill_position_array(segpos))) {
+            cells.assign(size_t(numrows) * 256U, eEmpty);
+            taken.assign(cells.size(), false);
+            for (size_t seg = 0; seg < segpos.size(); seg++) {
+                sssegments const* currseg = stage.get_segment(seg);
+                int const         length  = currseg->get_length();
+                for (auto const& row : currseg->get_objects()) {
+                    if (row.first >= length) {
+                        break;
+                    }
+                    for (auto const& elem : row.second) {
+                        cells[cell_index(segpos[seg] + row.first, elem.first)]
+                                = elem.second == sssegments::eBomb ? eBomb
+                                                                   : eRing;
+                    }
+                }
+            }
+        }
+
+        static Contents contents(sssegments::ObjectTypes type) noexcept {
+            return type == sssegments::eBomb ? eBomb : eRing;
+        }
+        int rows() const noexcept {
+            return numrows;
+        }
+        bool contains(int row) const noexcept {
+            return row >= 0 && row < numrows;
+        }
+        Contents get(int row, uint8_t angle) const noexcept {
+            return Contents(cells[cell_index(row, angle)]);
+        }
+        bool is_taken(int row, uint8_t angle) const noexcept {
+            return taken[cell_index(row, angle)];
+        }
+        void take(int row, uint8_t angle) noexcept {
+            taken[cell_index(row, angle)] = true;
+        }
+        // Object in the given stage row and angle.
+        object at(int row, uint8_t angle, Contents what) const {
+            auto const seg = std::distance(
+                    segpos.cbegin(),
+                    std::upper_bound(segpos.cbegin(), segpos.cend(), row)
+                            - 1);
+            return object(
+                    int(seg), angle, unsigned(row - segpos[size_t(seg)]),
+                    what == eBomb ? sssegments::eBomb : sssegments::eRing);
+        }
+    };
+
+    bool cell_matches(
+            insert_pattern::cell const& cell,
+            stage_grid::Contents what) noexcept {
+        if (what == stage_grid::eEmpty) {
+            return false;
+        }
+        return cell.type == insert_pattern::current_type
+               || stage_grid::contents(sssegments::ObjectTypes(cell.type))
+                          == what;
+    }
+}    // namespace
+
+vector<formation_match> formation_search::find(
+        insert_pattern const& pat, sslevels const& stage, unsigned index) {
+    vector<formation_match> found;
+    if (pat.cells.empty()) {
+        return found;
+    }
+    stage_grid                  grid(stage);
+    insert_pattern::cell const& first = pat.cells.front();
+
+    for (int row = 0; row < grid.rows(); row++) {
+        int const base = row - first.row;
+        for (unsigned angle = 0; angle < 256U; angle++) {
+            auto const pos = static_cast<uint8_t>(angle);
+            if (!cell_matches(first, grid.get(row, pos))
+                || grid.is_taken(row, pos)) {
+                continue;
+            }
+            auto const shift = static_cast<uint8_t>(pos - first.angle);
+            bool       match = true;
+            for (auto const& cell : pat.cells) {
+                int const     currrow   = base + cell.row;
+                uint8_t const currangle = static_cast<uint8_t>(
+                        shift + cell.angle);
+                if (!grid.contains(currrow)
+                    || !cell_matches(cell, grid.get(currrow, currangle))
+                    || grid.is_taken(currrow, currangle)) {
+                    match = false;
+                    break;
+                }
+            }
+            if (!match) {
+                continue;
+            }
+            vector<object> objs;
+            objs.reserve(pat.cells.size());
+            for (auto const& cell : pat.cells) {
+                int const     currrow   = base + cell.row;
+                uint8_t const currangle = static_cast<uint8_t>(
+                        shift + cell.angle);
+                objs.push_back(grid.at(
+                        currrow, currangle, grid.get(currrow, currangle)));
+                grid.take(currrow, currangle);
+            }
+            found.push_back(formation_match{
+                    index, row, pos, object_set(std::move(objs))});
+        }
+    }
+    return found;
+}
+
+vector<formation_match> formation_search::find(
+        insert_pattern const& pat, ssobj_file const& file) {
+    vector<formation_match> found;
+    for (size_t ii = 0; ii < file.num_stages(); ii++) {
+        vector<formation_match> curr
+                = find(pat, *file.get_stage(ii), unsigned(ii));
+        std::move(curr.begin(), curr.end(), std::back_inserter(found));
+    }
+    return found;
+}
+
+object_set formation_search::place(
+        insert_pattern const& pat, sslevels const& stage, int row,
+        uint8_t angle, sssegments::ObjectTypes deftype) {
+    vector<int> segpos;
+    int const   numrows = int(stage.fill_position_array(segpos));
+
+    vector<object> placed;
+    placed.reserve(pat.cells.size());
+    for (auto const& cell : pat.cells) {
+        int const currrow = row + cell.row;
+        if (currrow < 0 || currrow >= numrows) {
+            continue;
+        }
+        auto const seg = std::distance(
+                segpos.cbegin(),
+                std::upper_bound(segpos.cbegin(), segpos.cend(), currrow) - 1);
+        placed.emplace_back(
+                int(seg), static_cast<uint8_t>(angle + cell.angle),
+                unsigned(currrow - segpos[size_t(seg)]),
+                pat.get_type(cell, deftype));
+    }
+    return object_set(std::move(placed));
+}
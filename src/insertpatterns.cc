@@ -0,0 +1,116 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) Flamewing 2011-2019 <flamewing.sonic@gmail.com>
+ *
+ * S2-SSEdit is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * S2-SSEdit is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "s2ssedit/sseditor.hh"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+using std::cerr;
+using std::endl;
+using std::string;
+using std::to_string;
+using std::vector;
+
+// Patterns saved from the editor go here, and are read after the ones that
+// come with it.
+static string user_pattern_dir() {
+    return Glib::build_filename(Glib::get_user_config_dir(), "s2ssedit");
+}
+
+void sseditor::load_patterns(string const& datafile) {
+    vector<string> errors;
+    patterns.load_file(datafile, errors);
+    patterns.load_file(
+            Glib::build_filename(user_pattern_dir(), SS_PATTERN_FILE), errors);
+    for (auto const& elem : errors) {
+        cerr << elem << endl;
+    }
+}
+
+void sseditor::fill_pattern_combos() {
+    update_in_progress = true;
+    for (auto* combo : {pringpatterncombo, pbombpatterncombo}) {
+        combo->remove_all();
+        for (size_t ii = 0; ii < patterns.size(); ii++) {
+            combo->append(patterns[ii].name);
+        }
+        if (current_pattern < patterns.size()) {
+            combo->set_active(int(current_pattern));
+        }
+        combo->set_sensitive(!patterns.empty());
+    }
+    update_in_progress = false;
+}
+
+void sseditor::on_patterncombo_changed(Gtk::ComboBoxText* combo) {
+    int const row = combo->get_active_row_number();
+    if (update_in_progress || row < 0) {
+        return;
+    }
+    current_pattern = size_t(row);
+    // Both toolbars show the same pattern.
+    fill_pattern_combos();
+    if (combo == pringpatterncombo) {
+        pringmodebuttons[ePattern]->set_active(true);
+    } else {
+        pbombmodebuttons[ePattern]->set_active(true);
+    }
+    update();
+}
+
+void sseditor::on_savepatternbutton_clicked() {
+    if (!specialstages || selection.empty()) {
+        return;
+    }
+    Gtk::Dialog dialog("Save pattern", *main_win, true);
+    dialog.add_button("_Cancel", Gtk::RESPONSE_CANCEL);
+    dialog.add_button("_Save", Gtk::RESPONSE_OK);
+    dialog.set_default_response(Gtk::RESPONSE_OK);
+
+    Gtk::Entry name;
+    name.set_text("Pattern " + to_string(patterns.size() + 1));
+    name.set_activates_default(true);
+    dialog.get_content_area()->pack_start(name);
+    dialog.show_all();
+    if (dialog.run() != Gtk::RESPONSE_OK || name.get_text().empty()) {
+        return;
+    }
+
+    insert_pattern pat
+            = pattern_library::capture(name.get_text(), selection, segpos);
+    if (pat.cells.empty()) {
+        return;
+    }
+    string const dir  = user_pattern_dir();
+    string const file = Glib::build_filename(dir, SS_PATTERN_FILE);
+    constexpr const int dir_mode = 0755;
+    if (g_mkdir_with_parents(dir.c_str(), dir_mode) != 0
+        || !pattern_library::save(file, pat)) {
+        Gtk::MessageDialog error(
+                *main_win, "Could not save the pattern to '" + file + "'.",
+                false, Gtk::MESSAGE_ERROR);
+        error.run();
+    }
+    // The pattern can be used in this session even if it was not saved.
+    patterns.add(std::move(pat));
+    current_pattern = patterns.size() - 1;
+    fill_pattern_combos();
+    update();
+}
@@ -0,0 +1,66 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) Flamewing 2011-2019 <flamewing.sonic@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "s2ssedit/sseditor.hh"
+
+#include <algorithm>
+#include <cmath>
+
+using std::max;
+using std::min;
+
+bool sseditor::on_loadstrip_draw(Cairo::RefPtr<Cairo::Context> const& cr) {
+    int const width  = ploadstrip->get_allocated_width();
+    int const height = ploadstrip->get_allocated_height();
+    cr->set_source_rgb(0.0, 87.0 / 255.0, 116.0 / 255.0);
+    cr->paint();
+
+    if (!specialstages || segpos.empty()) {
+        sprite_estimate.clear();
+        return true;
+    }
+    // Only the windows touched by edits since the last draw are summed.
+    sprite_estimate.update(*specialstages->get_stage(currstage));
+
+    // Rows line up with the ones in the main view. Each bar is as long as
+    // the load is high, and goes from green to red as it nears the limit.
+    double const scroll = pvscrollbar->get_value();
+    auto const   first  = static_cast<size_t>(max(0.0, std::floor(scroll)));
+    auto const   last   = min(
+            sprite_estimate.size(),
+            first + static_cast<size_t>(height / SIMAGE_SIZE) + 2);
+    double const limit = stage_validator::max_safe_num_objs;
+    for (size_t row = first; row < last; row++) {
+        unsigned const total = sprite_estimate[row].total();
+        if (total == 0) {
+            continue;
+        }
+        double const load = min(1.0, total / limit);
+        if (total > limit) {
+            cr->set_source_rgb(1.0, 0.0, 0.0);
+        } else {
+            cr->set_source_rgb(
+                    min(1.0, 2.0 * load), min(1.0, 2.0 - 2.0 * load), 0.0);
+        }
+        cr->rectangle(
+                0.0, (static_cast<double>(row) - scroll) * SIMAGE_SIZE,
+                load * width, SIMAGE_SIZE);
+        cr->fill();
+    }
+    return true;
+}
@@ -17,11 +17,15 @@
  */
 
 #include "s2ssedit/sseditor.hh"
+#include "s2ssedit/thumbnails.hh"
 
 #include <array>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <string>
+#include <vector>
 
 /* For testing propose use the local (not installed) ui file */
 //#define DEBUG 1
@@ -36,6 +40,7 @@ using std::endl;
 using std::string;
 using std::tie;
 using std::to_string;
+using std::vector;
 
 #ifdef _WIN32
 #    include <io.h>
@@ -48,7 +53,80 @@ bool file_exists(const string& filename) {
     return access(filename.c_str(), 0) == 0;
 }
 
+static string find_data_file(const string& name) {
+    if (file_exists(PACKAGE_DATA_DIR + name)) {
+        return PACKAGE_DATA_DIR + name;
+    }
+    if (file_exists(DATADIR + name)) {
+        return DATADIR + name;
+    }
+    return "." + name;
+}
+
+// s2ssedit --thumbnails OUTDIR [--scale=FACTOR] DIR...
+static int thumbnails_main(int argc, char* argv[]) {
+    constexpr const char scale_opt[] = "--scale=";
+    if (argc < 4) {
+        cerr << "Usage: " << argv[0]
+             << " --thumbnails OUTDIR [--scale=FACTOR] DIR..." << endl;
+        return 1;
+    }
+    string         outdir = argv[2];
+    double         scale  = 0.25;
+    vector<string> dirs;
+    for (int ii = 3; ii < argc; ii++) {
+        if (strncmp(argv[ii], scale_opt, sizeof(scale_opt) - 1) == 0) {
+            scale = strtod(argv[ii] + sizeof(scale_opt) - 1, nullptr);
+            if (scale <= 0.0) {
+                cerr << "Invalid scale '" << argv[ii] << "'" << endl;
+                return 1;
+            }
+        } else {
+            dirs.emplace_back(argv[ii]);
+        }
+    }
+    size_t failures = render_thumbnails(
+            outdir, dirs, scale, find_data_file(RINGFILE),
+            find_data_file(BOMBFILE));
+    return failures == 0 ? 0 : 1;
+}
+
+// Takes the undo history options out of the command line, so that GTK does
+// not see them.
+static undo_history::limits parse_undo_options(int& argc, char* argv[]) {
+    constexpr const char   memory_opt[]  = "--undo-memory=";
+    constexpr const char   steps_opt[]   = "--undo-steps=";
+    constexpr const char   compact_opt[] = "--undo-compact";
+    constexpr const size_t mebibyte      = 1024U * 1024U;
+    constexpr const size_t default_limit = 64U;
+
+    undo_history::limits lim;
+    lim.max_bytes = default_limit * mebibyte;
+    int kept      = 1;
+    for (int ii = 1; ii < argc; ii++) {
+        char const* arg = argv[ii];
+        if (strncmp(arg, memory_opt, sizeof(memory_opt) - 1) == 0) {
+            double size = strtod(arg + sizeof(memory_opt) - 1, nullptr);
+            lim.max_bytes
+                    = size > 0.0 ? size_t(size * double(mebibyte)) : 0U;
+        } else if (strncmp(arg, steps_opt, sizeof(steps_opt) - 1) == 0) {
+            lim.max_steps = strtoul(arg + sizeof(steps_opt) - 1, nullptr, 10);
+        } else if (strcmp(arg, compact_opt) == 0) {
+            lim.compact = true;
+        } else {
+            argv[kept++] = argv[ii];
+        }
+    }
+    argc       = kept;
+    argv[argc] = nullptr;
+    return lim;
+}
+
 int main(int argc, char* argv[]) {
+    if (argc > 1 && strcmp(argv[1], "--thumbnails") == 0) {
+        return thumbnails_main(argc, argv);
+    }
+    undo_history::limits const undo_limits = parse_undo_options(argc, argv);
     try {
         auto app = Gtk::Application::create(
                 argc, argv, "org.flamewing.s2ssedit");
@@ -58,6 +136,7 @@ int main(int argc, char* argv[]) {
                           : (file_exists(DATADIR UI_FILE) ? DATADIR UI_FILE
                                                           : "./" UI_FILE);
         sseditor Editor(app, uifile.c_str());
+        Editor.set_undo_limits(undo_limits);
         Editor.run();
     } catch (const Glib::FileError& ex) {
         cerr << ex.what() << endl;
@@ -71,21 +150,41 @@ sseditor::sseditor(
         : update_in_progress(false), dragging(false), drop_enabled(false),
           currstage(0), currsegment(0), draw_width(0), draw_height(0),
           mouse_x(0), mouse_y(0), state(0), mode(eSelectMode),
-          ringmode(eSingle), bombmode(eSingle), copypos(0), drawbox(false),
-          snaptogrid(true), endpos(0), main_win(nullptr),
-          kit(std::move(application)), helpdlg(nullptr), aboutdlg(nullptr),
-          filedlg(nullptr), pspecialstageobjs(nullptr), pmodenotebook(nullptr),
+          ringmode(eSingle), bombmode(eSingle),
+          query_mode(eReplaceSelection), overlaps_all_stages(false),
+          formation_all_stages(false),
+          clipboard_owner(false),
+          clipboard_targets{}, drag_dangle(0), drag_dpos(0), drawbox(false),
+          snaptogrid(true), current_pattern(0), stages_dirty(true),
+          endpos(0), minimap_zoom(0),
+          minimap_scale(1.0),
+          minimap_top(-1.0), minimap_tile_width(0), minimap_tile_scale(0.0),
+          totals_stage(~0U), totals_interval(0),
+          play_row(0.0), play_speed(1.0), play_last_time(0), play_tick_id(0),
+          main_win(nullptr), kit(std::move(application)), helpdlg(nullptr),
+          aboutdlg(nullptr), filedlg(nullptr), pspecialstageobjs(nullptr),
+          pminimap(nullptr), ploadstrip(nullptr), pmodenotebook(nullptr),
           plabelcurrentstage(nullptr), plabeltotalstages(nullptr),
           plabelcurrentsegment(nullptr), plabeltotalsegments(nullptr),
           plabelcurrsegrings(nullptr), plabelcurrsegbombs(nullptr),
           plabelcurrsegshadows(nullptr), plabelcurrsegtotal(nullptr),
-          pimagecurrsegwarn(nullptr), pvscrollbar(nullptr),
+          plabelstagetotals(nullptr), plabelcheckpointtotals(nullptr),
+          pimagecurrsegwarn(nullptr), pproblemsview(nullptr),
+          plabelproblems(nullptr), pvscrollbar(nullptr),
           popenfilebutton(nullptr), psavefilebutton(nullptr),
-          prevertfilebutton(nullptr), pundobutton(nullptr),
+          prevertfilebutton(nullptr), pduplicatesbutton(nullptr),
+          pundobutton(nullptr),
           predobutton(nullptr), phelpbutton(nullptr), paboutbutton(nullptr),
           pquitbutton(nullptr), pmodebuttons{}, psnapgridbutton(nullptr),
+          pplaybutton(nullptr), pplayspeed(nullptr), plabelplayrow(nullptr),
+          plabelundo(nullptr),
           pcutbutton(nullptr), pcopybutton(nullptr), ppastebutton(nullptr),
-          pdeletebutton(nullptr), pringmodebuttons{}, pbombmodebuttons{},
+          pdeletebutton(nullptr), pquerybutton(nullptr),
+          psavepatternbutton(nullptr), poverlapbutton(nullptr),
+          pfindformationbutton(nullptr),
+          pringmodebuttons{},
+          pringpatterncombo(nullptr), pbombmodebuttons{},
+          pbombpatterncombo(nullptr),
           pstage_toolbar(nullptr), pfirst_stage_button(nullptr),
           pprevious_stage_button(nullptr), pnext_stage_button(nullptr),
           plast_stage_button(nullptr), pinsert_stage_before_button(nullptr),
@@ -108,18 +207,11 @@ sseditor::sseditor(
           psegment_left(nullptr), pobject_grid(nullptr), pmoveup(nullptr),
           pmovedown(nullptr), pmoveleft(nullptr), pmoveright(nullptr),
           pringtype(nullptr), pbombtype(nullptr) {
-    const std::string ringfile
-            = file_exists(PACKAGE_DATA_DIR RINGFILE)
-                      ? PACKAGE_DATA_DIR RINGFILE
-                      : (file_exists(DATADIR RINGFILE) ? DATADIR RINGFILE
-                                                       : "." RINGFILE);
-    const std::string bombfile
-            = file_exists(PACKAGE_DATA_DIR BOMBFILE)
-                      ? PACKAGE_DATA_DIR BOMBFILE
-                      : (file_exists(DATADIR BOMBFILE) ? DATADIR BOMBFILE
-                                                       : "." BOMBFILE);
-    ringimg = Gdk::Pixbuf::create_from_file(ringfile);
-    bombimg = Gdk::Pixbuf::create_from_file(bombfile);
+    const std::string ringfile = find_data_file(RINGFILE);
+    const std::string bombfile = find_data_file(BOMBFILE);
+    ringimg  = Gdk::Pixbuf::create_from_file(ringfile);
+    bombimg  = Gdk::Pixbuf::create_from_file(bombfile);
+    renderer = std::make_unique<ssrenderer>(ringfile, bombfile);
 
     // Load the Glade file and instiate its widgets:
     builder = Gtk::Builder::create_from_file(uifile);
@@ -128,6 +220,8 @@ sseditor::sseditor(
 
     // All hail sed...
     builder->get_widget("specialstageobjs", pspecialstageobjs);
+    builder->get_widget("minimap", pminimap);
+    builder->get_widget("loadstrip", ploadstrip);
     pfilefilter = Glib::RefPtr<Gtk::FileFilter>::cast_dynamic(
             builder->get_object("filefilter"));
     builder->get_widget("modenotebook", pmodenotebook);
@@ -140,14 +234,20 @@ sseditor::sseditor(
     builder->get_widget("labelcurrsegbombs", plabelcurrsegbombs);
     builder->get_widget("labelcurrsegshadows", plabelcurrsegshadows);
     builder->get_widget("labelcurrsegtotal", plabelcurrsegtotal);
+    builder->get_widget("labelstagetotals", plabelstagetotals);
+    builder->get_widget("labelcheckpointtotals", plabelcheckpointtotals);
     // Images
     builder->get_widget("imagecurrsegwarn", pimagecurrsegwarn);
+    // Problems panel
+    builder->get_widget("problemsview", pproblemsview);
+    builder->get_widget("labelproblems", plabelproblems);
     // Scrollbar
     builder->get_widget("vscrollbar", pvscrollbar);
     // Main toolbar
     builder->get_widget("openfilebutton", popenfilebutton);
     builder->get_widget("savefilebutton", psavefilebutton);
     builder->get_widget("revertfilebutton", prevertfilebutton);
+    builder->get_widget("duplicatesbutton", pduplicatesbutton);
     builder->get_widget("undobutton", pundobutton);
     builder->get_widget("redobutton", predobutton);
     builder->get_widget("selectmodebutton", pmodebuttons[eSelectMode]);
@@ -155,6 +255,10 @@ sseditor::sseditor(
     builder->get_widget("insertbombbutton", pmodebuttons[eInsertBombMode]);
     builder->get_widget("deletemodebutton", pmodebuttons[eDeleteMode]);
     builder->get_widget("snapgridbutton", psnapgridbutton);
+    builder->get_widget("playbutton", pplaybutton);
+    builder->get_widget("playspeed", pplayspeed);
+    builder->get_widget("labelplayrow", plabelplayrow);
+    builder->get_widget("labelundo", plabelundo);
     builder->get_widget("helpbutton", phelpbutton);
     builder->get_widget("aboutbutton", paboutbutton);
     builder->get_widget("quitbutton", pquitbutton);
@@ -163,6 +267,10 @@ sseditor::sseditor(
     builder->get_widget("copybutton", pcopybutton);
     builder->get_widget("pastebutton", ppastebutton);
     builder->get_widget("deletebutton", pdeletebutton);
+    builder->get_widget("querybutton", pquerybutton);
+    builder->get_widget("savepatternbutton", psavepatternbutton);
+    builder->get_widget("overlapbutton", poverlapbutton);
+    builder->get_widget("findformationbutton", pfindformationbutton);
     // Insert ring toolbar
     builder->get_widget("ringsinglebutton", pringmodebuttons[eSingle]);
     builder->get_widget("ringlinebutton", pringmodebuttons[eLine]);
@@ -172,6 +280,8 @@ sseditor::sseditor(
     builder->get_widget("ringlozengebutton", pringmodebuttons[eLozenge]);
     builder->get_widget("ringstarbutton", pringmodebuttons[eStar]);
     builder->get_widget("ringtrianglebutton", pringmodebuttons[eTriangle]);
+    builder->get_widget("ringpatternbutton", pringmodebuttons[ePattern]);
+    builder->get_widget("ringpatterncombo", pringpatterncombo);
     // Insert bomb toolbar
     builder->get_widget("bombsinglebutton", pbombmodebuttons[eSingle]);
     builder->get_widget("bomblinebutton", pbombmodebuttons[eLine]);
@@ -181,6 +291,8 @@ sseditor::sseditor(
     builder->get_widget("bomblozengebutton", pbombmodebuttons[eLozenge]);
     builder->get_widget("bombstarbutton", pbombmodebuttons[eStar]);
     builder->get_widget("bombtrianglebutton", pbombmodebuttons[eTriangle]);
+    builder->get_widget("bombpatternbutton", pbombmodebuttons[ePattern]);
+    builder->get_widget("bombpatterncombo", pbombpatterncombo);
     // Special stage toolbar
     builder->get_widget("stage_toolbar", pstage_toolbar);
     builder->get_widget("first_stage_button", pfirst_stage_button);
@@ -256,6 +368,25 @@ sseditor::sseditor(
             sigc::mem_fun(this, &sseditor::on_specialstageobjs_drag_data_get));
     pspecialstageobjs->signal_drag_end().connect(
             sigc::mem_fun(this, &sseditor::on_specialstageobjs_drag_end));
+    // Minimap
+    pminimap->signal_draw().connect(
+            sigc::mem_fun(this, &sseditor::on_minimap_draw));
+    pminimap->signal_button_press_event().connect(
+            sigc::mem_fun(this, &sseditor::on_minimap_button_press_event));
+    pminimap->signal_motion_notify_event().connect(
+            sigc::mem_fun(this, &sseditor::on_minimap_motion_notify_event));
+    pminimap->signal_scroll_event().connect(
+            sigc::mem_fun(this, &sseditor::on_minimap_scroll_event));
+    // Sprite load strip
+    ploadstrip->signal_draw().connect(
+            sigc::mem_fun(this, &sseditor::on_loadstrip_draw));
+    // Problems panel
+    problemstore = Gtk::ListStore::create(problem_cols);
+    pproblemsview->set_model(problemstore);
+    pproblemsview->append_column("Where", problem_cols.where);
+    pproblemsview->append_column("Problem", problem_cols.problem);
+    pproblemsview->signal_row_activated().connect(
+            sigc::mem_fun(this, &sseditor::on_problemsview_row_activated));
     // Scrollbar
     pvscrollbar->signal_value_changed().connect(
             sigc::mem_fun(this, &sseditor::on_vscrollbar_value_changed));
@@ -266,6 +397,8 @@ sseditor::sseditor(
             sigc::mem_fun(this, &sseditor::on_savefilebutton_clicked));
     prevertfilebutton->signal_clicked().connect(
             sigc::mem_fun(this, &sseditor::on_revertfilebutton_clicked));
+    pduplicatesbutton->signal_clicked().connect(
+            sigc::mem_fun(this, &sseditor::on_duplicatesbutton_clicked));
     pundobutton->signal_clicked().connect(
             sigc::mem_fun(this, &sseditor::on_undobutton_clicked));
     predobutton->signal_clicked().connect(
@@ -280,6 +413,10 @@ sseditor::sseditor(
             sigc::mem_fun(this, &sseditor::on_modebutton_toggled<eDeleteMode>));
     psnapgridbutton->signal_toggled().connect(
             sigc::mem_fun(this, &sseditor::on_snapgridbutton_toggled), true);
+    pplaybutton->signal_toggled().connect(
+            sigc::mem_fun(this, &sseditor::on_playbutton_toggled));
+    pplayspeed->signal_value_changed().connect(
+            sigc::mem_fun(this, &sseditor::on_playspeed_value_changed));
     phelpbutton->signal_clicked().connect(
             sigc::mem_fun(this, &sseditor::on_helpbutton_clicked));
     paboutbutton->signal_clicked().connect(
@@ -295,6 +432,14 @@ sseditor::sseditor(
             sigc::mem_fun(this, &sseditor::on_pastebutton_clicked));
     pdeletebutton->signal_clicked().connect(
             sigc::mem_fun(this, &sseditor::on_deletebutton_clicked));
+    pquerybutton->signal_clicked().connect(
+            sigc::mem_fun(this, &sseditor::on_querybutton_clicked));
+    psavepatternbutton->signal_clicked().connect(
+            sigc::mem_fun(this, &sseditor::on_savepatternbutton_clicked));
+    poverlapbutton->signal_clicked().connect(
+            sigc::mem_fun(this, &sseditor::on_overlapbutton_clicked));
+    pfindformationbutton->signal_clicked().connect(
+            sigc::mem_fun(this, &sseditor::on_findformationbutton_clicked));
     // Insert ring toolbar
     pringmodebuttons[eSingle]->signal_toggled().connect(
             sigc::mem_fun(this, &sseditor::on_ringmode_toggled<eSingle>));
@@ -312,6 +457,10 @@ sseditor::sseditor(
             sigc::mem_fun(this, &sseditor::on_ringmode_toggled<eStar>));
     pringmodebuttons[eTriangle]->signal_toggled().connect(
             sigc::mem_fun(this, &sseditor::on_ringmode_toggled<eTriangle>));
+    pringmodebuttons[ePattern]->signal_toggled().connect(
+            sigc::mem_fun(this, &sseditor::on_ringmode_toggled<ePattern>));
+    pringpatterncombo->signal_changed().connect(
+            sigc::mem_fun(this, &sseditor::on_ringpatterncombo_changed));
     // Insert bomb toolbar
     pbombmodebuttons[eSingle]->signal_toggled().connect(
             sigc::mem_fun(this, &sseditor::on_bombmode_toggled<eSingle>));
@@ -329,6 +478,10 @@ sseditor::sseditor(
             sigc::mem_fun(this, &sseditor::on_bombmode_toggled<eStar>));
     pbombmodebuttons[eTriangle]->signal_toggled().connect(
             sigc::mem_fun(this, &sseditor::on_bombmode_toggled<eTriangle>));
+    pbombmodebuttons[ePattern]->signal_toggled().connect(
+            sigc::mem_fun(this, &sseditor::on_bombmode_toggled<ePattern>));
+    pbombpatterncombo->signal_changed().connect(
+            sigc::mem_fun(this, &sseditor::on_bombpatterncombo_changed));
     // Special stage toolbar
     pfirst_stage_button->signal_clicked().connect(
             sigc::mem_fun(this, &sseditor::on_first_stage_button_clicked));
@@ -437,6 +590,22 @@ sseditor::sseditor(
             this, &sseditor::on_objecttype_toggled<
                           sssegments::eBomb, &sseditor::pbombtype>));
 
+    // Another editor may have copied something before this one started.
+    Gtk::Clipboard::get()->signal_owner_change().connect(
+            sigc::mem_fun(this, &sseditor::on_clipboard_owner_change));
+    on_clipboard_owner_change(nullptr);
+
+    load_patterns(find_data_file("/" SS_PATTERN_FILE));
+    fill_pattern_combos();
+
+    // Edits are logged as they are made, and flushed to disk every few
+    // seconds.
+    constexpr const unsigned journal_sync_seconds = 2;
+    history.set_journal(&journal);
+    Glib::signal_timeout().connect_seconds(
+            sigc::mem_fun(this, &sseditor::on_journal_timeout),
+            journal_sync_seconds);
+
     update();
 }
 
@@ -448,7 +617,7 @@ void update_array(array<Gtk::RadioToolButton*, N>& buttons, bool state) {
 }
 
 void sseditor::update() {
-    if (update_in_progress) {
+    if (update_in_progress || history.in_transaction()) {
         return;
     }
 
@@ -457,6 +626,7 @@ void sseditor::update() {
     if (!specialstages) {
         psavefilebutton->set_sensitive(false);
         prevertfilebutton->set_sensitive(false);
+        pduplicatesbutton->set_sensitive(false);
 
         update_array(pmodebuttons, false);
 
@@ -477,8 +647,9 @@ void sseditor::update() {
     } else {
         psavefilebutton->set_sensitive(true);
         prevertfilebutton->set_sensitive(true);
-        pundobutton->set_sensitive(!undostack.empty());
-        predobutton->set_sensitive(!redostack.empty());
+        pduplicatesbutton->set_sensitive(true);
+        pundobutton->set_sensitive(history.can_undo());
+        predobutton->set_sensitive(history.can_redo());
 
         update_array(pmodebuttons, true);
 
@@ -503,6 +674,10 @@ void sseditor::update() {
             pcopybutton->set_sensitive(false);
             ppastebutton->set_sensitive(false);
             pdeletebutton->set_sensitive(false);
+            pquerybutton->set_sensitive(false);
+            psavepatternbutton->set_sensitive(false);
+            poverlapbutton->set_sensitive(false);
+            pfindformationbutton->set_sensitive(false);
             psegment_toolbar->set_sensitive(false);
             psegment_grid->set_sensitive(false);
             pobject_grid->set_sensitive(false);
@@ -527,7 +702,9 @@ void sseditor::update() {
             pinsert_stage_before_button->set_sensitive(true);
             pcut_stage_button->set_sensitive(true);
             pcopy_stage_button->set_sensitive(true);
-            ppaste_stage_button->set_sensitive(copylevel != nullptr);
+            ppaste_stage_button->set_sensitive(
+                    copylevel != nullptr
+                    || clipboard_targets[object_payload::eStage]);
             pdelete_stage_button->set_sensitive(true);
             plabeltotalstages->set_label(to_string(numstages));
             plabelcurrentstage->set_label(to_string(currstage + 1));
@@ -552,6 +729,10 @@ void sseditor::update() {
                 pcopybutton->set_sensitive(false);
                 ppastebutton->set_sensitive(false);
                 pdeletebutton->set_sensitive(false);
+                pquerybutton->set_sensitive(false);
+                psavepatternbutton->set_sensitive(false);
+                poverlapbutton->set_sensitive(false);
+                pfindformationbutton->set_sensitive(false);
                 psegment_grid->set_sensitive(false);
                 pobject_grid->set_sensitive(false);
                 pringtype->set_inconsistent(true);
@@ -571,13 +752,21 @@ void sseditor::update() {
             } else {
                 pcutbutton->set_sensitive(!selection.empty());
                 pcopybutton->set_sensitive(!selection.empty());
-                ppastebutton->set_sensitive(!copystack.empty());
+                ppastebutton->set_sensitive(
+                        !copyrows.empty()
+                        || clipboard_targets[object_payload::eObjectRows]);
                 pdeletebutton->set_sensitive(!selection.empty());
+                pquerybutton->set_sensitive(true);
+                psavepatternbutton->set_sensitive(!selection.empty());
+                poverlapbutton->set_sensitive(true);
+                pfindformationbutton->set_sensitive(!selection.empty());
 
                 pinsert_segment_before_button->set_sensitive(true);
                 pcut_segment_button->set_sensitive(true);
                 pcopy_segment_button->set_sensitive(true);
-                ppaste_segment_button->set_sensitive(copyseg != nullptr);
+                ppaste_segment_button->set_sensitive(
+                        copyseg != nullptr
+                        || clipboard_targets[object_payload::eSegment]);
                 pdelete_segment_button->set_sensitive(true);
 
                 psegment_grid->set_sensitive(true);
@@ -593,9 +782,9 @@ void sseditor::update() {
                         to_string(currseg->get_numshadows()));
                 plabelcurrsegtotal->set_label(
                         to_string(currseg->get_totalobjs()) + "/100");
-                constexpr const uint16_t max_safe_num_objs = 100;
                 pimagecurrsegwarn->set_visible(
-                        currseg->get_totalobjs() > max_safe_num_objs);
+                        currseg->get_totalobjs()
+                        > stage_validator::max_safe_num_objs);
 
                 segment_type_button(currseg->get_type())->set_active(true);
                 geometry_button(currseg->get_geometry())->set_active(true);
@@ -620,6 +809,13 @@ void sseditor::update() {
         }
     }
 
+    update_play_label();
+    update_undo_label();
+    update_stage_totals();
+    if (stages_dirty) {
+        update_problems();
+    }
+    stages_dirty = false;
     show();
 
     update_in_progress = false;
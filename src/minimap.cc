@@ -0,0 +1,216 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) Flamewing 2011-2019 <flamewing.sonic@gmail.com>
+ *
+ * S2-SSEdit is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * S2-SSEdit is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "s2ssedit/sseditor.hh"
+
+#include <algorithm>
+#include <cmath>
+
+using std::max;
+using std::min;
+using std::upper_bound;
+
+void sseditor::update_minimap_scale(int width, int height) {
+    constexpr const unsigned max_zoom  = 6U;
+    constexpr const double   max_scale = 4.0;
+
+    minimap_zoom     = min(minimap_zoom, max_zoom);
+    double const fit = endpos > 0 ? static_cast<double>(height) / endpos : 1.0;
+    minimap_scale    = min(fit * (1U << minimap_zoom), max(fit, max_scale));
+
+    // Only scroll the minimap when the main view leaves it, so that the
+    // minimap stays put while it is being clicked or dragged on.
+    double const visible = height / minimap_scale;
+    double const page    = static_cast<double>(draw_height) / SIMAGE_SIZE;
+    double const first   = pvscrollbar->get_value();
+    if (minimap_top < 0.0 || first < minimap_top
+        || first + page > minimap_top + visible) {
+        minimap_top = first + (page - visible) / 2.0;
+    }
+    minimap_top = clamp(minimap_top, 0.0, max(0.0, endpos - visible));
+
+    if (width != minimap_tile_width || minimap_scale != minimap_tile_scale) {
+        minimap_tiles.clear();
+        minimap_tile_width = width;
+        minimap_tile_scale = minimap_scale;
+    }
+}
+
+Cairo::RefPtr<Cairo::ImageSurface> sseditor::get_minimap_tile(
+        sssegments const& seg) {
+    auto it = minimap_tiles.find(seg.get_revision());
+    if (it != minimap_tiles.end()) {
+        return it->second;
+    }
+
+    int const len    = seg.get_length();
+    int const height = max(1, static_cast<int>(std::ceil(len * minimap_scale)));
+    auto      tile   = Cairo::ImageSurface::create(
+            Cairo::FORMAT_ARGB32, minimap_tile_width, height);
+    auto cr = Cairo::Context::create(tile);
+
+    // Objects are half an image wide, or 8 units of angle.
+    double const xscale = minimap_tile_width / 256.0;
+    double const dotw   = max(1.0, HALF_IMAGE_SIZE * xscale);
+    double const doth   = max(1.0, minimap_scale);
+    for (auto const& row : seg.get_objects()) {
+        if (row.first >= len) {
+            continue;
+        }
+        double const ty = row.first * minimap_scale;
+        for (auto const& elem : row.second) {
+            if (elem.second == sssegments::eBomb) {
+                cr->set_source_rgb(1.0, 0.0, 0.0);
+            } else {
+                cr->set_source_rgb(1.0, 1.0, 0.0);
+            }
+            double const tx = angle_simple(elem.first) * xscale - dotw / 2.0;
+            cr->rectangle(tx, ty, dotw, doth);
+            cr->fill();
+        }
+    }
+
+    switch (seg.get_type()) {
+    case sssegments::eCheckpoint:
+        cr->set_source_rgb(1.0, 1.0, 1.0);
+        break;
+    case sssegments::eChaosEmerald:
+        cr->set_source_rgb(0.0, 1.0, 0.0);
+        break;
+    case sssegments::eRingsMessage:
+        cr->set_source_rgb(0.0, 1.0, 1.0);
+        break;
+    case sssegments::eNormalSegment:
+        cr->set_source_rgba(1.0, 1.0, 1.0, 0.25);
+        break;
+    }
+    cr->rectangle(0.0, height - 1.0, minimap_tile_width, 1.0);
+    cr->fill();
+
+    minimap_tiles.emplace(seg.get_revision(), tile);
+    return tile;
+}
+
+bool sseditor::on_minimap_draw(Cairo::RefPtr<Cairo::Context> const& cr) {
+    int const width  = pminimap->get_allocated_width();
+    int const height = pminimap->get_allocated_height();
+    cr->set_source_rgb(0.0, 87.0 / 255.0, 116.0 / 255.0);
+    cr->paint();
+
+    if (!specialstages || segpos.empty()) {
+        return true;
+    }
+
+    update_minimap_scale(width, height);
+
+    // Tube floor, from angle 0x00 to angle 0x80.
+    double const xscale = width / 256.0;
+    cr->set_source_rgb(0.0, 116.0 / 255.0, 144.0 / 255.0);
+    cr->rectangle(
+            angle_simple(0x00) * xscale, 0.0,
+            (angle_simple(0x80) - angle_simple(0x00)) * xscale, height);
+    cr->fill();
+
+    sslevels*    currlvl = specialstages->get_stage(currstage);
+    double const last    = minimap_top + height / minimap_scale;
+    auto it = upper_bound(segpos.begin(), segpos.end(), minimap_top);
+    if (it != segpos.begin()) {
+        --it;
+    }
+    for (; it != segpos.end() && *it < last; ++it) {
+        auto const seg  = static_cast<size_t>(it - segpos.begin());
+        auto       tile = get_minimap_tile(*currlvl->get_segment(seg));
+        cr->set_source(tile, 0.0, (*it - minimap_top) * minimap_scale);
+        cr->paint();
+    }
+
+    // Part of the stage shown in the main view.
+    double const page = static_cast<double>(draw_height) / SIMAGE_SIZE;
+    double const vy = (pvscrollbar->get_value() - minimap_top) * minimap_scale;
+    double const vh = max(2.0, page * minimap_scale);
+    cr->rectangle(0.5, vy + 0.5, width - 1.0, vh - 1.0);
+    cr->set_source_rgba(1.0, 1.0, 1.0, 0.25);
+    cr->fill_preserve();
+    cr->set_source_rgb(1.0, 1.0, 1.0);
+    cr->set_line_width(1.0);
+    cr->stroke();
+
+    // Tiles of segments that were edited away are never reused; drop them
+    // once they clearly outnumber the live ones.
+    if (minimap_tiles.size() > 2 * segpos.size() + 64) {
+        minimap_tiles.clear();
+    }
+    return true;
+}
+
+void sseditor::minimap_jump(double y) {
+    double const row  = minimap_top + y / minimap_scale;
+    double const page = static_cast<double>(draw_height) / SIMAGE_SIZE;
+    pvscrollbar->set_value(row - page / 2.0);
+}
+
+bool sseditor::on_minimap_button_press_event(GdkEventButton* event) {
+    if (!specialstages || event->button != GDK_BUTTON_PRIMARY) {
+        return true;
+    }
+    minimap_jump(event->y);
+    return true;
+}
+
+bool sseditor::on_minimap_motion_notify_event(GdkEventMotion* event) {
+    if (!specialstages || (event->state & GDK_BUTTON1_MASK) == 0) {
+        return true;
+    }
+    minimap_jump(event->y);
+    return true;
+}
+
+bool sseditor::on_minimap_scroll_event(GdkEventScroll* event) {
+    if (!specialstages) {
+        return false;
+    }
+
+    double delta = 0.0;
+    switch (event->direction) {
+    case GDK_SCROLL_UP:
+        delta = -1.0;
+        break;
+    case GDK_SCROLL_DOWN:
+        delta = 1.0;
+        break;
+    case GDK_SCROLL_SMOOTH:
+        // No way around C API here.
+        delta = event->delta_y;
+        break;
+    case GDK_SCROLL_LEFT:
+    case GDK_SCROLL_RIGHT:
+        return true;
+    }
+
+    if (delta < 0.0) {
+        minimap_zoom++;
+    } else if (delta > 0.0 && minimap_zoom > 0) {
+        minimap_zoom--;
+    } else {
+        return true;
+    }
+    // Recenter on the main view at the new scale.
+    minimap_top = -1.0;
+    pminimap->queue_draw();
+    return true;
+}
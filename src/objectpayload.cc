@@ -0,0 +1,261 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) Flamewing 2011-2019 <flamewing.sonic@gmail.com>
+ *
+ * S2-SSEdit is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * S2-SSEdit is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "s2ssedit/objectpayload.hh"
+
+#include <algorithm>
+#include <cstring>
+#include <istream>
+#include <sstream>
+#include <streambuf>
+#include <type_traits>
+#include <vector>
+
+using std::istream;
+using std::ostringstream;
+using std::string;
+using std::vector;
+
+static_assert(
+        std::is_trivially_copyable<object>::value
+                && sizeof(object) == object_payload::record_size,
+        "objects must be stored as bare keys");
+
+namespace {
+    constexpr const char magic[4] = {'S', '2', 'S', 'D'};
+
+    // Layout of the packed rows.
+    constexpr const uint32_t row_shift   = 9U;
+    constexpr const uint32_t angle_shift = 1U;
+    constexpr const uint32_t sign_bit    = 1U << (31U - row_shift);
+
+    constexpr bool little_endian() noexcept {
+        return __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__;
+    }
+
+    void put_le32(unsigned char* ptr, uint32_t value) noexcept {
+        for (size_t ii = 0; ii < 4; ii++, value >>= 8U) {
+            ptr[ii] = static_cast<unsigned char>(value & 0xffU);
+        }
+    }
+
+    uint32_t get_le32(unsigned char const* ptr) noexcept {
+        uint32_t value = 0;
+        for (size_t ii = 4; ii-- > 0;) {
+            value = (value << 8U) | ptr[ii];
+        }
+        return value;
+    }
+
+    void put_header(
+            unsigned char* ptr, object_payload::Kinds kind, size_t count) {
+        std::memcpy(ptr, magic, sizeof(magic));
+        ptr[4] = object_payload::version;
+        ptr[5] = kind;
+        ptr[6] = 0;
+        ptr[7] = 0;
+        put_le32(ptr + 8, static_cast<uint32_t>(count));
+    }
+
+    // Checks the header; on success, returns the count and leaves data and
+    // len pointing to the contents.
+    bool get_header(
+            unsigned char const*& data, size_t& len,
+            object_payload::Kinds kind, size_t& count) {
+        if (len < object_payload::header_size
+            || std::memcmp(data, magic, sizeof(magic)) != 0
+            || data[4] != object_payload::version || data[5] != kind) {
+            return false;
+        }
+        count = get_le32(data + 8);
+        data += object_payload::header_size;
+        len -= object_payload::header_size;
+        return true;
+    }
+
+    // Records of a fixed size; checks that they fill the contents.
+    bool get_records(
+            void const* data, size_t len, object_payload::Kinds kind,
+            unsigned char const*& ptr, size_t& count) {
+        ptr = static_cast<unsigned char const*>(data);
+        return get_header(ptr, len, kind, count)
+               && len / object_payload::record_size == count
+               && len % object_payload::record_size == 0;
+    }
+
+    // Reads straight from the payload, without copying it to a string.
+    class payload_buffer : public std::streambuf {
+    public:
+        payload_buffer(unsigned char const* data, size_t len) {
+            // The get area is never written to.
+            char* begin = const_cast<char*>(
+                    reinterpret_cast<char const*>(data));
+            setg(begin, begin, begin + len);
+        }
+        size_t remaining() const noexcept {
+            return size_t(egptr() - gptr());
+        }
+    };
+
+    template <typename T>
+    string encode_stream(object_payload::Kinds kind, size_t count, T const& t) {
+        ostringstream out;
+        unsigned char header[object_payload::header_size];
+        put_header(header, kind, count);
+        out.write(reinterpret_cast<char const*>(header), sizeof(header));
+        t.write(out);
+        return out.str();
+    }
+
+    template <typename T>
+    bool decode_stream(
+            void const* data, size_t len, object_payload::Kinds kind, T& t) {
+        auto const* ptr = static_cast<unsigned char const*>(data);
+        size_t      count;
+        if (!get_header(ptr, len, kind, count)) {
+            return false;
+        }
+        payload_buffer buffer(ptr, len);
+        istream        in(&buffer);
+        T              result;
+        result.read(in);
+        // A complete payload is used up exactly.
+        if (in.fail() || buffer.remaining() != 0) {
+            return false;
+        }
+        t = std::move(result);
+        return true;
+    }
+}    // namespace
+
+char const* object_payload::target(Kinds kind) noexcept {
+    switch (kind) {
+    case eObjects:
+        return SS_OBJECTS_TARGET;
+    case eObjectRows:
+        return SS_ROWS_TARGET;
+    case eSegment:
+        return SS_SEGMENT_TARGET;
+    case eStage:
+        return SS_STAGE_TARGET;
+    case eNumKinds:
+        break;
+    }
+    __builtin_unreachable();
+}
+
+string object_payload::encode(object_set const& objs) {
+    size_t const count = objs.size();
+    string       out(header_size + count * record_size, '\0');
+    auto*        ptr = reinterpret_cast<unsigned char*>(&out[0]);
+    put_header(ptr, eObjects, count);
+    ptr += header_size;
+    if (count != 0 && little_endian()) {
+        std::memcpy(ptr, &*objs.begin(), count * record_size);
+    } else {
+        for (auto const& elem : objs) {
+            put_le32(ptr, elem.get_key());
+            ptr += record_size;
+        }
+    }
+    return out;
+}
+
+string object_payload::encode(vector<object_row> const& rows) {
+    size_t const count = rows.size();
+    string       out(header_size + count * record_size, '\0');
+    auto*        ptr = reinterpret_cast<unsigned char*>(&out[0]);
+    put_header(ptr, eObjectRows, count);
+    ptr += header_size;
+    for (auto const& elem : rows) {
+        put_le32(
+                ptr, (static_cast<uint32_t>(elem.row) << row_shift)
+                             | (uint32_t(elem.angle) << angle_shift)
+                             | (elem.type == sssegments::eBomb ? 1U : 0U));
+        ptr += record_size;
+    }
+    return out;
+}
+
+string object_payload::encode(sssegments const& sgm) {
+    return encode_stream(eSegment, 1, sgm);
+}
+
+string object_payload::encode(sslevels const& lvl) {
+    return encode_stream(eStage, lvl.num_segments(), lvl);
+}
+
+bool object_payload::decode(void const* data, size_t len, object_set& objs) {
+    unsigned char const* ptr;
+    size_t               count;
+    if (!get_records(data, len, eObjects, ptr, count)) {
+        return false;
+    }
+
+    vector<object> found(count);
+    if (count != 0 && little_endian()) {
+        std::memcpy(found.data(), ptr, count * record_size);
+    } else {
+        for (auto& elem : found) {
+            elem = object::from_key(get_le32(ptr));
+            ptr += record_size;
+        }
+    }
+    found.erase(
+            std::remove_if(
+                    found.begin(), found.end(),
+                    [](object const& obj) { return !obj.valid(); }),
+            found.end());
+    // The keys came from elsewhere; the set sorts them if they are not in
+    // order.
+    object_set(std::move(found)).swap(objs);
+    return true;
+}
+
+bool object_payload::decode(
+        void const* data, size_t len, vector<object_row>& rows) {
+    unsigned char const* ptr;
+    size_t               count;
+    if (!get_records(data, len, eObjectRows, ptr, count)) {
+        return false;
+    }
+
+    vector<object_row> found;
+    found.reserve(count);
+    for (size_t ii = 0; ii < count; ii++, ptr += record_size) {
+        uint32_t const packed = get_le32(ptr);
+        uint32_t const value  = packed >> row_shift;
+        int32_t        row    = static_cast<int32_t>(value & (sign_bit - 1U));
+        if ((value & sign_bit) != 0) {
+            row -= static_cast<int32_t>(sign_bit);
+        }
+        found.push_back(object_row{
+                row, static_cast<uint8_t>(packed >> angle_shift),
+                (packed & 1U) != 0 ? sssegments::eBomb : sssegments::eRing});
+    }
+    rows.swap(found);
+    return true;
+}
+
+bool object_payload::decode(void const* data, size_t len, sssegments& sgm) {
+    return decode_stream(data, len, eSegment, sgm);
+}
+
+bool object_payload::decode(void const* data, size_t len, sslevels& lvl) {
+    return decode_stream(data, len, eStage, lvl);
+}
@@ -0,0 +1,99 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) Flamewing 2011-2019 <flamewing.sonic@gmail.com>
+ *
+ * S2-SSEdit is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * S2-SSEdit is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "s2ssedit/objectquery.hh"
+
+#include <algorithm>
+
+using std::min;
+
+object_query::SegmentTypeMask object_query::type_mask(
+        sssegments::SegmentTypes t) noexcept {
+    switch (t) {
+    case sssegments::eNormalSegment:
+        return eNormalMask;
+    case sssegments::eRingsMessage:
+        return eRingsMessageMask;
+    case sssegments::eCheckpoint:
+        return eCheckpointMask;
+    case sssegments::eChaosEmerald:
+        return eChaosEmeraldMask;
+    }
+    __builtin_unreachable();
+}
+
+bool object_query::matches(
+        uint8_t angle, sssegments::ObjectTypes t) const noexcept {
+    switch (type) {
+    case eAnyType:
+        break;
+    case eRingsOnly:
+        if (t != sssegments::eRing) {
+            return false;
+        }
+        break;
+    case eBombsOnly:
+        if (t != sssegments::eBomb) {
+            return false;
+        }
+        break;
+    }
+    switch (height) {
+    case eAnyHeight:
+        break;
+    case eAerialOnly:
+        if (!sssegments::is_aerial(angle)) {
+            return false;
+        }
+        break;
+    case eGroundOnly:
+        if (sssegments::is_aerial(angle)) {
+            return false;
+        }
+        break;
+    }
+    if (first_angle <= last_angle) {
+        return angle >= first_angle && angle <= last_angle;
+    }
+    return angle >= first_angle || angle <= last_angle;
+}
+
+object_set object_query::run(sslevels const& stage) const {
+    object_set result;
+    if (stage.num_segments() == 0 || first_row > last_row) {
+        return result;
+    }
+    size_t const last = min(last_segment, stage.num_segments() - 1);
+    for (size_t seg = first_segment; seg <= last; seg++) {
+        sssegments const* currseg = stage.get_segment(seg);
+        if (!matches(*currseg)) {
+            continue;
+        }
+        auto const& objects = currseg->get_objects();
+        auto        it      = objects.lower_bound(first_row);
+        auto        end     = objects.upper_bound(last_row);
+        for (; it != end; ++it) {
+            for (auto const& elem : it->second) {
+                if (matches(elem.first, elem.second)) {
+                    result.emplace(seg, elem.first, it->first, elem.second);
+                }
+            }
+        }
+    }
+    return result;
+}
@@ -0,0 +1,162 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) Flamewing 2011-2019 <flamewing.sonic@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "s2ssedit/overlapfinder.hh"
+
+#include "s2ssedit/ignore_unused_variable_warning.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <unordered_map>
+#include <utility>
+
+using std::max;
+using std::min;
+using std::vector;
+
+namespace {
+    // Objects of a stage hashed by (row / row gap, angle / angle gap). The
+    // last column of cells takes the angles left over, so every column is
+    // at least a gap wide, and objects less than a gap apart are always in
+    // the same or in neighbouring cells.
+    class overlap_grid {
+    private:
+        struct placed {
+            int     row;
+            uint8_t angle;
+            object  obj;
+        };
+
+        std::unordered_map<uint64_t, vector<placed>> cells;
+        unsigned angle_gap, row_gap, columns;
+
+        unsigned column(uint8_t angle) const noexcept {
+            return min(unsigned(angle) / angle_gap, columns - 1);
+        }
+        static uint64_t cell_key(int row, unsigned col) noexcept {
+            return (uint64_t(uint32_t(row)) << 32U) | col;
+        }
+        bool near(placed const& other, int row, uint8_t angle) const noexcept {
+            auto const dangle = uint8_t(angle - other.angle);
+            return unsigned(std::abs(row - other.row)) < row_gap
+                   && min(dangle, uint8_t(-dangle)) < angle_gap;
+        }
+
+    public:
+        overlap_grid(unsigned angles, unsigned rows) noexcept
+                : angle_gap(angles), row_gap(rows), columns(256U / angles) {}
+
+        void insert(int row, uint8_t angle, object obj) {
+            cells[cell_key(row / int(row_gap), column(angle))].push_back(
+                    placed{row, angle, obj});
+        }
+        // Calls found with each object that overlaps (row, angle).
+        template <typename Found>
+        void visit(int row, uint8_t angle, Found found) const {
+            // Columns are at least two, and with two the neighbours on both
+            // sides are the same.
+            unsigned const col     = column(angle);
+            unsigned const cols[3] = {
+                    col, (col + 1) % columns, (col + columns - 1) % columns};
+            unsigned const numcols = min(columns, 3U);
+            int const      base    = row / int(row_gap);
+            for (int cellrow = max(base - 1, 0); cellrow <= base + 1;
+                 cellrow++) {
+                for (unsigned ii = 0; ii < numcols; ii++) {
+                    auto it = cells.find(cell_key(cellrow, cols[ii]));
+                    if (it == cells.end()) {
+                        continue;
+                    }
+                    for (auto const& elem : it->second) {
+                        if (near(elem, row, angle)) {
+                            found(elem.obj);
+                        }
+                    }
+                }
+            }
+        }
+    };
+
+    // Calls func with the stage row, angle and object of each object of the
+    // stage, in stage order.
+    template <typename Func>
+    void for_each_object(sslevels const& stage, Func func) {
+        int pos = 0;
+        for (size_t seg = 0; seg < stage.num_segments(); seg++) {
+            sssegments const* currseg = stage.get_segment(seg);
+            int const         length  = currseg->get_length();
+            for (auto const& row : currseg->get_objects()) {
+                if (row.first >= length) {
+                    break;
+                }
+                for (auto const& elem : row.second) {
+                    func(pos + row.first, elem.first,
+                         object(int(seg), elem.first, row.first,
+                                elem.second));
+                }
+            }
+            pos += length;
+        }
+    }
+}    // namespace
+
+overlap_finder::overlap_finder(unsigned angles, unsigned rows) noexcept
+        : angle_gap(min(max(angles, 1U), unsigned(max_angle_gap))),
+          row_gap(max(rows, 1U)) {}
+
+vector<object_overlap> overlap_finder::find(
+        sslevels const& stage, unsigned index) const {
+    vector<object_overlap> found;
+    overlap_grid           grid(angle_gap, row_gap);
+    for_each_object(stage, [&](int row, uint8_t angle, object obj) {
+        grid.visit(row, angle, [&](object other) {
+            found.push_back(object_overlap{index, other, obj});
+        });
+        grid.insert(row, angle, obj);
+    });
+    return found;
+}
+
+vector<object_overlap> overlap_finder::find(ssobj_file const& file) const {
+    vector<object_overlap> found;
+    for (size_t ii = 0; ii < file.num_stages(); ii++) {
+        vector<object_overlap> curr = find(*file.get_stage(ii), unsigned(ii));
+        found.insert(found.end(), curr.cbegin(), curr.cend());
+    }
+    return found;
+}
+
+object_set overlap_finder::redundant(sslevels const& stage) const {
+    vector<object> found;
+    overlap_grid   grid(angle_gap, row_gap);
+    for_each_object(stage, [&](int row, uint8_t angle, object obj) {
+        bool covered = false;
+        grid.visit(row, angle, [&covered](object other) {
+            ignore_unused_variable_warning(other);
+            covered = true;
+        });
+        // Only the objects that stay can make others redundant.
+        if (covered) {
+            found.push_back(obj);
+        } else {
+            grid.insert(row, angle, obj);
+        }
+    });
+    return object_set(std::move(found));
+}
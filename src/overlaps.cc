@@ -0,0 +1,158 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) Flamewing 2011-2019 <flamewing.sonic@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "s2ssedit/sseditor.hh"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+using std::string;
+using std::to_string;
+using std::vector;
+
+void sseditor::on_overlapbutton_clicked() {
+    if (!specialstages || segpos.empty()) {
+        return;
+    }
+
+    Gtk::Dialog dialog("Find overlapping objects", *main_win, true);
+    dialog.add_button("_Cancel", Gtk::RESPONSE_CANCEL);
+    dialog.add_button("_Find", Gtk::RESPONSE_OK);
+    dialog.set_default_response(Gtk::RESPONSE_OK);
+
+    Gtk::Grid grid;
+    grid.set_row_spacing(4);
+    grid.set_column_spacing(8);
+    grid.set_border_width(8);
+    int  line     = 0;
+    auto add_line = [&grid, &line](char const* text, Gtk::Widget& widget) {
+        auto* label = Gtk::manage(new Gtk::Label(text));
+        label->set_halign(Gtk::ALIGN_START);
+        grid.attach(*label, 0, line, 1, 1);
+        grid.attach(widget, 1, line, 1, 1);
+        line++;
+    };
+
+    Gtk::SpinButton angle_gap;
+    angle_gap.set_range(1.0, double(overlap_finder::max_angle_gap));
+    angle_gap.set_increments(1.0, 8.0);
+    angle_gap.set_value(overlaps.get_angle_gap());
+    angle_gap.set_tooltip_text(
+            "Objects fewer angles apart than this overlap; a sprite is 8");
+    add_line("Angle gap:", angle_gap);
+
+    Gtk::SpinButton row_gap;
+    row_gap.set_range(1.0, double(sssegments::eTurnThenRiseLen));
+    row_gap.set_increments(1.0, 4.0);
+    row_gap.set_value(overlaps.get_row_gap());
+    row_gap.set_tooltip_text(
+            "Objects fewer rows apart than this overlap; a sprite is 1");
+    add_line("Row gap:", row_gap);
+
+    Gtk::ComboBoxText scope;
+    scope.append("Current stage");
+    scope.append("All stages");
+    scope.set_active(overlaps_all_stages ? 1 : 0);
+    add_line("Search:", scope);
+
+    Gtk::CheckButton fix("Remove redundant objects");
+    fix.set_tooltip_text(
+            "Of each group of overlapping objects, keep the first in the "
+            "stage");
+    grid.attach(fix, 1, line, 1, 1);
+    line++;
+
+    dialog.get_content_area()->pack_start(grid);
+    dialog.show_all();
+    if (dialog.run() != Gtk::RESPONSE_OK) {
+        return;
+    }
+    dialog.hide();
+
+    overlaps = overlap_finder(
+            unsigned(angle_gap.get_value_as_int()),
+            unsigned(row_gap.get_value_as_int()));
+    overlaps_all_stages = scope.get_active_row_number() == 1;
+    size_t const first  = overlaps_all_stages ? 0 : currstage;
+    size_t const last
+            = overlaps_all_stages ? specialstages->num_stages() : currstage + 1;
+
+    if (fix.get_active()) {
+        // All stages are fixed in a single undo step.
+        size_t removed = 0;
+        begin_edits();
+        for (size_t stage = first; stage < last; stage++) {
+            object_set redundant
+                    = overlaps.redundant(*specialstages->get_stage(stage));
+            if (!redundant.empty()) {
+                removed += redundant.size();
+                do_action<delete_selection_action>(
+                        int(stage), std::move(redundant));
+            }
+        }
+        selection.clear();
+        hotstack.clear();
+        commit_edits();
+        Gtk::MessageDialog info(
+                *main_win,
+                removed == 0 ? string("No overlapping objects found.")
+                             : "Removed " + to_string(removed)
+                                       + " redundant objects.",
+                false, Gtk::MESSAGE_INFO);
+        info.run();
+        return;
+    }
+
+    // Both objects of each overlap in the current stage are selected.
+    vector<object> found;
+    size_t         elsewhere = 0;
+    for (size_t stage = first; stage < last; stage++) {
+        vector<object_overlap> const curr = overlaps.find(
+                *specialstages->get_stage(stage), unsigned(stage));
+        if (stage != currstage) {
+            elsewhere += curr.size();
+            continue;
+        }
+        for (auto const& elem : curr) {
+            found.push_back(elem.first);
+            found.push_back(elem.second);
+        }
+    }
+    size_t const here = found.size() / 2;
+    selection         = object_set(std::move(found));
+    hotstack.clear();
+    if (!selection.empty()) {
+        int pos = get_obj_pos<int>(*selection.begin());
+        int top = get_scroll();
+        if (pos < top || pos >= top + draw_height / SIMAGE_SIZE) {
+            pvscrollbar->set_value(pos);
+        }
+    }
+    update();
+
+    string text = to_string(here) + " overlapping pairs in this stage";
+    if (overlaps_all_stages) {
+        text += ", " + to_string(elsewhere) + " in other stages";
+    }
+    Gtk::MessageDialog info(*main_win, text + ".", false, Gtk::MESSAGE_INFO);
+    if (here != 0) {
+        info.set_secondary_text("The overlapping objects are now selected.");
+    }
+    info.run();
+}
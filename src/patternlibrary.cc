@@ -0,0 +1,291 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) Flamewing 2011-2019 <flamewing.sonic@gmail.com>
+ *
+ * S2-SSEdit is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * S2-SSEdit is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "s2ssedit/patternlibrary.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+
+using std::getline;
+using std::ifstream;
+using std::istream;
+using std::istringstream;
+using std::map;
+using std::ofstream;
+using std::ostringstream;
+using std::pair;
+using std::string;
+using std::vector;
+
+namespace {
+    // Largest number of objects a parametric pattern can make.
+    constexpr const long max_count = 4096;
+
+    using raw_cell = pair<long, long>;
+
+    bool parse_long(string const& text, long& value) {
+        try {
+            size_t len = 0;
+            value      = std::stol(text, &len, 0);
+            return len == text.size();
+        } catch (std::exception const&) {
+            return false;
+        }
+    }
+
+    bool parse_type(string const& text, uint8_t& type) {
+        if (text == "r") {
+            type = sssegments::eRing;
+        } else if (text == "b") {
+            type = sssegments::eBomb;
+        } else if (text == "*") {
+            type = insert_pattern::current_type;
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    // Reads the key=value parameters of a parametric pattern; only the keys
+    // already in params are accepted.
+    bool read_parameters(
+            istream& in, map<string, long>& params, string& error) {
+        string token;
+        while (in >> token) {
+            auto const eq = token.find('=');
+            long       value;
+            if (eq == string::npos
+                || !parse_long(token.substr(eq + 1), value)) {
+                error = "expected key=value, got '" + token + "'";
+                return false;
+            }
+            auto it = params.find(token.substr(0, eq));
+            if (it == params.end()) {
+                error = "unknown parameter '" + token.substr(0, eq) + "'";
+                return false;
+            }
+            it->second = value;
+        }
+        return true;
+    }
+
+    bool read_stamp(
+            istream& in, vector<raw_cell>& raw, vector<uint8_t>& types,
+            string& error) {
+        string token;
+        while (in >> token) {
+            istringstream fields(token);
+            string        row;
+            string        angle;
+            string        type = "*";
+            long          r;
+            long          a;
+            uint8_t       t;
+            if (!getline(fields, row, ':') || !getline(fields, angle, ':')
+                || (!fields.eof() && !getline(fields, type))
+                || !parse_long(row, r) || !parse_long(angle, a)
+                || !parse_type(type, t)) {
+                error = "expected row:angle:type, got '" + token + "'";
+                return false;
+            }
+            raw.emplace_back(r, a);
+            types.push_back(t);
+        }
+        return true;
+    }
+
+    long round_to_long(double value) {
+        return std::lround(value);
+    }
+}    // namespace
+
+bool pattern_library::compile(
+        string const& definition, insert_pattern& pat, string& error) {
+    istringstream in(definition);
+    string        kind;
+    string        name;
+    if (!(in >> kind >> std::quoted(name)) || name.empty()) {
+        error = "expected a kind and a quoted name";
+        return false;
+    }
+
+    vector<raw_cell> raw;
+    vector<uint8_t>  types;
+    if (kind == "stamp") {
+        if (!read_stamp(in, raw, types, error)) {
+            return false;
+        }
+    } else {
+        map<string, long> params{{"count", 8}, {"spacing", 1}};
+        if (kind == "line") {
+            params.emplace("step", 0);
+        } else if (kind == "arc") {
+            params["count"] = 9;
+            params.emplace("radius", 4);
+            params.emplace("width", 32);
+            params.emplace("span", 180);
+            params.erase("spacing");
+        } else if (kind == "spiral") {
+            params.emplace("turns", 1);
+        } else if (kind == "wave") {
+            params.emplace("amplitude", 16);
+            params.emplace("period", 8);
+        } else {
+            error = "unknown pattern kind '" + kind + "'";
+            return false;
+        }
+        if (!read_parameters(in, params, error)) {
+            return false;
+        }
+        long const count = params["count"];
+        if (count < 1 || count > max_count) {
+            error = "count must be between 1 and " + std::to_string(max_count);
+            return false;
+        }
+        if (kind == "wave" && params["period"] == 0) {
+            error = "period can't be zero";
+            return false;
+        }
+        constexpr const double pi = 3.14159265358979323846;
+        for (long k = 0; k < count; k++) {
+            if (kind == "arc") {
+                double const frac = count > 1 ? double(k) / (count - 1) : 0.5;
+                double const t = params["span"] * (frac - 0.5) * pi / 180.0;
+                raw.emplace_back(
+                        round_to_long(params["radius"] * (1.0 - std::cos(t))),
+                        round_to_long(params["width"] * std::sin(t)));
+                continue;
+            }
+            long const row = k * params["spacing"];
+            if (kind == "line") {
+                raw.emplace_back(row, k * params["step"]);
+            } else if (kind == "spiral") {
+                raw.emplace_back(
+                        row, round_to_long(
+                                     double(k) * 0x100 * params["turns"]
+                                     / count));
+            } else {
+                double const t = 2.0 * pi * double(k) / params["period"];
+                raw.emplace_back(
+                        row,
+                        round_to_long(params["amplitude"] * std::sin(t)));
+            }
+        }
+        uint8_t const type = insert_pattern::current_type;
+        types.assign(raw.size(), type);
+    }
+
+    constexpr const long min_row = std::numeric_limits<int16_t>::min();
+    constexpr const long max_row = std::numeric_limits<int16_t>::max();
+    vector<insert_pattern::cell> cells;
+    cells.reserve(raw.size());
+    for (size_t ii = 0; ii < raw.size(); ii++) {
+        if (raw[ii].first < min_row || raw[ii].first > max_row) {
+            error = "pattern is too long";
+            return false;
+        }
+        cells.push_back(insert_pattern::cell{
+                static_cast<int16_t>(raw[ii].first),
+                static_cast<uint8_t>(raw[ii].second & 0xff), types[ii]});
+    }
+    // Sorted by position, with the first of any duplicates kept.
+    auto const less = [](insert_pattern::cell const& lhs,
+                         insert_pattern::cell const& rhs) {
+        return lhs.row != rhs.row ? lhs.row < rhs.row : lhs.angle < rhs.angle;
+    };
+    auto const same = [](insert_pattern::cell const& lhs,
+                         insert_pattern::cell const& rhs) {
+        return lhs.row == rhs.row && lhs.angle == rhs.angle;
+    };
+    std::stable_sort(cells.begin(), cells.end(), less);
+    cells.erase(std::unique(cells.begin(), cells.end(), same), cells.end());
+    if (cells.empty()) {
+        error = "pattern has no objects";
+        return false;
+    }
+
+    pat.name       = std::move(name);
+    pat.cells      = std::move(cells);
+    pat.definition = definition;
+    return true;
+}
+
+void pattern_library::load(
+        istream& in, string const& source, vector<string>& errors) {
+    string line;
+    for (size_t lineno = 1; getline(in, line); lineno++) {
+        auto const first = line.find_first_not_of(" \t\r");
+        if (first == string::npos || line[first] == '#') {
+            continue;
+        }
+        auto const last = line.find_last_not_of(" \t\r");
+        insert_pattern pat;
+        string         error;
+        if (compile(line.substr(first, last + 1 - first), pat, error)) {
+            patterns.push_back(std::move(pat));
+        } else {
+            errors.push_back(
+                    source + ":" + std::to_string(lineno) + ": " + error);
+        }
+    }
+}
+
+void pattern_library::load_file(string const& path, vector<string>& errors) {
+    ifstream in(path);
+    if (in.good()) {
+        load(in, path, errors);
+    }
+}
+
+insert_pattern pattern_library::capture(
+        string const& name, object_set const& objs,
+        vector<int> const& segpos) {
+    insert_pattern pat;
+    if (objs.empty()) {
+        return pat;
+    }
+    // Sets are in stage order, so the first object is the top left one.
+    object const& anchor = *objs.begin();
+    auto const    row0 = segpos[anchor.get_segment()] + anchor.get_pos();
+    ostringstream out;
+    out << "stamp " << std::quoted(name);
+    for (auto const& elem : objs) {
+        int const row   = segpos[elem.get_segment()] + elem.get_pos() - row0;
+        int const angle = (elem.get_angle() - anchor.get_angle()) & 0xff;
+        out << ' ' << row << ':' << angle << ':'
+            << (elem.get_type() == sssegments::eBomb ? 'b' : 'r');
+    }
+    string error;
+    if (!compile(out.str(), pat, error)) {
+        return insert_pattern{};
+    }
+    return pat;
+}
+
+bool pattern_library::save(string const& path, insert_pattern const& pat) {
+    ofstream out(path, std::ios::app);
+    out << pat.definition << '\n';
+    return out.good();
+}
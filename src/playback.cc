@@ -0,0 +1,126 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) Flamewing 2011-2019 <flamewing.sonic@gmail.com>
+ *
+ * S2-SSEdit is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * S2-SSEdit is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "s2ssedit/sseditor.hh"
+
+#include <algorithm>
+#include <string>
+
+using std::min;
+using std::to_string;
+
+void sseditor::on_playbutton_toggled() {
+    if (pplaybutton->get_active()) {
+        start_playback();
+    } else {
+        stop_playback();
+    }
+}
+
+void sseditor::start_playback() {
+    if (playing() || !specialstages || segpos.empty()) {
+        pplaybutton->set_active(false);
+        return;
+    }
+    // Restart from the top when playback had reached the end.
+    auto const adj = pvscrollbar->get_adjustment();
+    if (get_scroll() >= adj->get_upper() - adj->get_page_size()) {
+        pvscrollbar->set_value(0.0);
+    }
+    play_row       = get_scroll();
+    play_last_time = 0;
+    play_tick_id   = pspecialstageobjs->add_tick_callback(
+            sigc::mem_fun(this, &sseditor::on_playback_tick));
+    pplaybutton->set_icon_name("media-playback-pause");
+}
+
+void sseditor::stop_playback() {
+    if (playing()) {
+        pspecialstageobjs->remove_tick_callback(play_tick_id);
+        play_tick_id = 0;
+    }
+    pplaybutton->set_icon_name("media-playback-start");
+    if (pplaybutton->get_active()) {
+        pplaybutton->set_active(false);
+    }
+}
+
+bool sseditor::on_playback_tick(Glib::RefPtr<Gdk::FrameClock> const& clock) {
+    // The game advances the stage by one row per frame, at 60 frames/s.
+    constexpr const double rows_per_second = 60.0;
+    constexpr const double usecs_per_sec   = 1000000.0;
+    // Longest gap between ticks that is played back in full; longer stalls
+    // (window hidden, system busy) resume where they left off.
+    constexpr const double max_tick_gap = 0.1;
+
+    if (!specialstages || segpos.empty()) {
+        play_tick_id = 0;
+        stop_playback();
+        return false;
+    }
+
+    // Pick up any scrolling done by the user since the last tick.
+    if (static_cast<int>(play_row) != get_scroll()) {
+        play_row = get_scroll();
+    }
+
+    // Advance by elapsed time rather than by tick count, so the speed is the
+    // same regardless of the monitor refresh rate or dropped frames.
+    gint64 const now = clock->get_frame_time();
+    if (play_last_time != 0) {
+        double elapsed = (now - play_last_time) / usecs_per_sec;
+        play_row += min(elapsed, max_tick_gap) * rows_per_second * play_speed;
+    }
+    play_last_time = now;
+
+    auto const   adj     = pvscrollbar->get_adjustment();
+    double const lastrow = adj->get_upper() - adj->get_page_size();
+    bool const   done    = play_row >= lastrow;
+    if (done) {
+        play_row = lastrow;
+    }
+
+    int const row = static_cast<int>(play_row);
+    if (row != get_scroll()) {
+        // Only refresh the side panel when the segment changes; otherwise,
+        // a repaint of the canvas is all that is needed.
+        size_t const seg = find_segment(row);
+        update_in_progress = true;
+        pvscrollbar->set_value(row);
+        update_in_progress = false;
+        if (seg != currsegment) {
+            currsegment = seg;
+            update();
+        } else {
+            update_play_label();
+            render();
+        }
+    }
+
+    if (done) {
+        play_tick_id = 0;
+        stop_playback();
+        return false;
+    }
+    return true;
+}
+
+void sseditor::update_play_label() {
+    plabelplayrow->set_label(
+            "Row " + to_string(get_scroll()) + "/" + to_string(endpos));
+}
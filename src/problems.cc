@@ -0,0 +1,90 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) Flamewing 2011-2019 <flamewing.sonic@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "s2ssedit/ignore_unused_variable_warning.hh"
+#include "s2ssedit/sseditor.hh"
+
+#include <algorithm>
+#include <string>
+
+using std::string;
+using std::to_string;
+
+void sseditor::update_problems() {
+    // Only segments changed since the last run are checked again, and the
+    // list is only refilled if that found something different.
+    bool const changed = specialstages ? validator.run(*specialstages)
+                                       : validator.clear();
+    if (!changed) {
+        return;
+    }
+    problemstore->clear();
+    auto const& issues = validator.get_issues();
+    for (size_t ii = 0; ii < issues.size(); ii++) {
+        auto const& issue = issues[ii];
+        string      where = "Stage " + to_string(issue.stage + 1);
+        if (issue.segment != validation_issue::none) {
+            where += ", segment " + to_string(issue.segment + 1);
+        }
+        Gtk::TreeRow row          = *problemstore->append();
+        row[problem_cols.where]   = where;
+        row[problem_cols.problem] = issue.describe();
+        row[problem_cols.index]   = unsigned(ii);
+    }
+    plabelproblems->set_markup(
+            "<b>Problems (" + to_string(issues.size()) + ")</b>");
+}
+
+void sseditor::on_problemsview_row_activated(
+        Gtk::TreePath const& path, Gtk::TreeViewColumn* column) {
+    ignore_unused_variable_warning(column);
+    if (!specialstages || update_in_progress) {
+        return;
+    }
+    Gtk::TreeIter iter = problemstore->get_iter(path);
+    if (!iter) {
+        return;
+    }
+    unsigned const index  = (*iter)[problem_cols.index];
+    auto const&    issues = validator.get_issues();
+    if (index < issues.size()) {
+        goto_issue(issues[index]);
+    }
+}
+
+void sseditor::goto_issue(validation_issue const& issue) {
+    if (issue.stage >= specialstages->num_stages()) {
+        return;
+    }
+    currstage = issue.stage;
+    selection.clear();
+    hotstack.clear();
+    update_segment_positions(false);
+    if (!segpos.empty()) {
+        auto const seg = issue.segment == validation_issue::none
+                                 ? 0U
+                                 : unsigned(issue.segment);
+        goto_segment(std::min(seg, unsigned(segpos.size() - 1)));
+        // Objects in the wrong place are selected, so they can be fixed.
+        if (issue.row != validation_issue::none && mode == eSelectMode) {
+            selection.emplace(
+                    issue.segment, issue.angle, issue.row, issue.type);
+        }
+    }
+    update();
+}
@@ -0,0 +1,187 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) Flamewing 2011-2019 <flamewing.sonic@gmail.com>
+ *
+ * S2-SSEdit is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * S2-SSEdit is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "s2ssedit/renderprofile.hh"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <string>
+
+using std::array;
+using std::max;
+using std::ostream;
+using std::ostringstream;
+using std::string;
+
+static constexpr const array<char const*, render_profile::eNumPhases>
+        phase_names{"background", "beams", "balls", "objects", "overlays"};
+
+double render_profile::elapsed_since_mark() {
+    auto   now  = clock::now();
+    double time = std::chrono::duration<double, std::milli>(now - mark).count();
+    mark        = now;
+    return time;
+}
+
+void render_profile::begin(Phases phase) {
+    double time = elapsed_since_mark();
+    if (!stack.empty()) {
+        current.times[stack.back()] += time;
+    }
+    stack.push_back(phase);
+}
+
+void render_profile::end() {
+    double time = elapsed_since_mark();
+    if (!stack.empty()) {
+        current.times[stack.back()] += time;
+        stack.pop_back();
+    }
+}
+
+void render_profile::begin_frame() {
+    current = frame{};
+    stack.clear();
+    frame_start = mark = clock::now();
+}
+
+void render_profile::end_frame() {
+    current.total
+            = std::chrono::duration<double, std::milli>(
+                      clock::now() - frame_start)
+                      .count();
+    history.push_back(current);
+    recent.push_back(current);
+    if (recent.size() > max_recent) {
+        recent.pop_front();
+    }
+}
+
+void render_profile::clear() {
+    recent.clear();
+    history.clear();
+}
+
+void render_profile::write_csv(ostream& out) const {
+    out << "frame";
+    for (auto const* name : phase_names) {
+        out << ',' << name << "_ms";
+    }
+    out << ",total_ms,objects\n";
+    size_t index = 0;
+    for (auto const& elem : history) {
+        out << index++;
+        for (double time : elem.times) {
+            out << ',' << time;
+        }
+        out << ',' << elem.total << ',' << elem.objects << '\n';
+    }
+}
+
+void render_profile::draw(
+        Cairo::RefPtr<Cairo::Context> const& cr, double x, double y) const {
+    // Histogram buckets: frame times up to 1, 2, 4, 8, 16 and 32 ms, and
+    // anything slower.
+    constexpr const size_t num_buckets = 7;
+    constexpr const double line_height = 14.0;
+    constexpr const double bar_width   = 24.0;
+    constexpr const double bar_height  = 48.0;
+    constexpr const double width       = num_buckets * bar_width + 16.0;
+    constexpr const double height
+            = (eNumPhases + 3) * line_height + bar_height + 24.0;
+
+    frame                          average;
+    array<size_t, num_buckets>     buckets{};
+    for (auto const& elem : recent) {
+        for (size_t ii = 0; ii < elem.times.size(); ii++) {
+            average.times[ii] += elem.times[ii];
+        }
+        average.total += elem.total;
+        average.objects += elem.objects;
+        size_t bucket = 0;
+        for (double limit = 1.0; bucket + 1 < num_buckets && elem.total > limit;
+             limit *= 2.0) {
+            bucket++;
+        }
+        buckets[bucket]++;
+    }
+    if (!recent.empty()) {
+        double const count = recent.size();
+        for (double& time : average.times) {
+            time /= count;
+        }
+        average.total /= count;
+        average.objects /= recent.size();
+    }
+
+    cr->save();
+    cr->set_source_rgba(0.0, 0.0, 0.0, 0.75);
+    cr->rectangle(x, y, width, height);
+    cr->fill();
+
+    cr->set_source_rgb(1.0, 1.0, 1.0);
+    cr->select_font_face(
+            "monospace", Cairo::FONT_SLANT_NORMAL, Cairo::FONT_WEIGHT_NORMAL);
+    cr->set_font_size(11.0);
+    double ty   = y + line_height;
+    auto   line = [&](string const& text) {
+        cr->move_to(x + 8.0, ty);
+        cr->show_text(text);
+        ty += line_height;
+    };
+    auto format = [](char const* name, double time) {
+        ostringstream out;
+        out << std::left << std::setw(11) << name << std::right
+            << std::fixed << std::setprecision(3) << std::setw(8) << time
+            << " ms";
+        return out.str();
+    };
+    line("Average of " + std::to_string(recent.size()) + " frames");
+    for (size_t ii = 0; ii < phase_names.size(); ii++) {
+        line(format(phase_names[ii], average.times[ii]));
+    }
+    line(format("total", average.total));
+    line("objects    " + std::to_string(average.objects));
+
+    // Histogram, scaled to the fullest bucket.
+    size_t const tallest
+            = max<size_t>(1, *std::max_element(buckets.begin(), buckets.end()));
+    double const base = ty + bar_height - line_height / 2;
+    for (size_t ii = 0; ii < num_buckets; ii++) {
+        double const bar = bar_height * buckets[ii] / tallest;
+        double const bx  = x + 8.0 + ii * bar_width;
+        // Green while a frame fits in 16 ms, red afterwards.
+        if (ii < num_buckets - 2) {
+            cr->set_source_rgb(0.0, 0.8, 0.0);
+        } else {
+            cr->set_source_rgb(0.9, 0.0, 0.0);
+        }
+        cr->rectangle(bx, base - bar, bar_width - 2.0, bar);
+        cr->fill();
+    }
+    cr->set_source_rgb(1.0, 1.0, 1.0);
+    cr->set_font_size(9.0);
+    static constexpr const array<char const*, num_buckets> labels{
+            "1", "2", "4", "8", "16", "32", ">32"};
+    for (size_t ii = 0; ii < num_buckets; ii++) {
+        cr->move_to(x + 8.0 + ii * bar_width, base + line_height - 2.0);
+        cr->show_text(labels[ii]);
+    }
+    cr->restore();
+}
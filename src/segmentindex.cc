@@ -0,0 +1,139 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) Flamewing 2011-2019 <flamewing.sonic@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "s2ssedit/segmentindex.hh"
+
+#include <algorithm>
+
+using std::unordered_map;
+using std::vector;
+
+namespace {
+    // 64-bit FNV-1a.
+    constexpr const uint64_t fnv_offset = 0xcbf29ce484222325ULL;
+    constexpr const uint64_t fnv_prime  = 0x100000001b3ULL;
+
+    void hash_byte(uint64_t& hash, uint8_t value) noexcept {
+        hash = (hash ^ value) * fnv_prime;
+    }
+}    // namespace
+
+uint64_t segment_index::content_hash(sssegments const& seg) noexcept {
+    uint64_t hash = fnv_offset;
+    hash_byte(hash, seg.get_flip_geom());
+    for (auto const& row : seg.get_objects()) {
+        for (auto const& elem : row.second) {
+            hash_byte(hash, uint8_t(elem.second | row.first));
+            hash_byte(hash, elem.first);
+        }
+    }
+    hash_byte(hash, uint8_t(seg.get_type()));
+    return hash;
+}
+
+bool segment_index::same_content(
+        sssegments const& lhs, sssegments const& rhs) noexcept {
+    // Copies share their revision until one of them changes.
+    if (lhs.get_revision() == rhs.get_revision()) {
+        return true;
+    }
+    if (lhs.get_flip_geom() != rhs.get_flip_geom()
+        || lhs.get_type() != rhs.get_type()) {
+        return false;
+    }
+    // Rows can be left empty by deletions, so they are compared by objects.
+    auto const& lobjs = lhs.get_objects();
+    auto const& robjs = rhs.get_objects();
+    auto        lit   = lobjs.cbegin();
+    auto        rit   = robjs.cbegin();
+    while (true) {
+        while (lit != lobjs.cend() && lit->second.empty()) {
+            ++lit;
+        }
+        while (rit != robjs.cend() && rit->second.empty()) {
+            ++rit;
+        }
+        if (lit == lobjs.cend() || rit == robjs.cend()) {
+            return lit == lobjs.cend() && rit == robjs.cend();
+        }
+        if (lit->first != rit->first || lit->second != rit->second) {
+            return false;
+        }
+        ++lit;
+        ++rit;
+    }
+}
+
+void segment_index::update(ssobj_file const& file) {
+    // Only the hashes of the segments still around are kept.
+    unordered_map<uint64_t, uint64_t>       fresh;
+    unordered_map<uint64_t, vector<size_t>> byhash;
+    vector<duplicate_group>                 groups;
+    vector<sssegments const*>               firsts;
+    for (size_t stage = 0; stage < file.num_stages(); stage++) {
+        sslevels const* currlvl = file.get_stage(stage);
+        for (size_t seg = 0; seg < currlvl->num_segments(); seg++) {
+            sssegments const* currseg  = currlvl->get_segment(seg);
+            uint64_t const    revision = currseg->get_revision();
+            auto const        it       = hashes.find(revision);
+            uint64_t const    hash
+                    = it != hashes.end() ? it->second : content_hash(*currseg);
+            fresh[revision] = hash;
+
+            location const where{unsigned(stage), unsigned(seg)};
+            vector<size_t>& candidates = byhash[hash];
+            auto const      same       = std::find_if(
+                    candidates.cbegin(), candidates.cend(),
+                    [&](size_t index) {
+                        return same_content(*firsts[index], *currseg);
+                    });
+            if (same != candidates.cend()) {
+                groups[*same].copies.push_back(where);
+                continue;
+            }
+            candidates.push_back(groups.size());
+            groups.emplace_back();
+            groups.back().copies.push_back(where);
+            groups.back().size = currseg->size();
+            firsts.push_back(currseg);
+        }
+    }
+    hashes.swap(fresh);
+
+    groups.erase(
+            std::remove_if(
+                    groups.begin(), groups.end(),
+                    [](duplicate_group const& group) {
+                        return group.copies.size() < 2;
+                    }),
+            groups.end());
+    std::stable_sort(
+            groups.begin(), groups.end(),
+            [](duplicate_group const& lhs, duplicate_group const& rhs) {
+                return lhs.wasted() > rhs.wasted();
+            });
+    duplicates.swap(groups);
+}
+
+size_t segment_index::wasted_bytes() const noexcept {
+    size_t total = 0;
+    for (auto const& elem : duplicates) {
+        total += elem.wasted();
+    }
+    return total;
+}
@@ -0,0 +1,211 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) Flamewing 2011-2019 <flamewing.sonic@gmail.com>
+ *
+ * S2-SSEdit is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * S2-SSEdit is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "s2ssedit/sseditor.hh"
+
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+using std::hex;
+using std::ostringstream;
+using std::setfill;
+using std::setw;
+using std::string;
+
+static string angle_to_string(uint8_t angle) {
+    ostringstream out;
+    out << "0x" << hex << setw(2) << setfill('0') << unsigned(angle);
+    return out.str();
+}
+
+static bool parse_angle(string const& text, uint8_t& angle) {
+    try {
+        size_t        len   = 0;
+        unsigned long value = std::stoul(text, &len, 0);
+        if (len != text.size() || value > 0xffU) {
+            return false;
+        }
+        angle = static_cast<uint8_t>(value);
+        return true;
+    } catch (std::exception const&) {
+        return false;
+    }
+}
+
+void sseditor::on_querybutton_clicked() {
+    if (!specialstages || segpos.empty()) {
+        return;
+    }
+    sslevels const* currlvl     = specialstages->get_stage(currstage);
+    auto const      numsegments = double(currlvl->num_segments());
+
+    Gtk::Dialog dialog("Select objects", *main_win, true);
+    dialog.add_button("_Cancel", Gtk::RESPONSE_CANCEL);
+    dialog.add_button("_Select", Gtk::RESPONSE_OK);
+    dialog.set_default_response(Gtk::RESPONSE_OK);
+
+    Gtk::Grid grid;
+    grid.set_row_spacing(4);
+    grid.set_column_spacing(8);
+    grid.set_border_width(8);
+    int  line     = 0;
+    auto add_line = [&grid, &line](
+                            char const* text, Gtk::Widget& first,
+                            Gtk::Widget* second) {
+        auto* label = Gtk::manage(new Gtk::Label(text));
+        label->set_halign(Gtk::ALIGN_START);
+        grid.attach(*label, 0, line, 1, 1);
+        grid.attach(first, 1, line, second != nullptr ? 1 : 2, 1);
+        if (second != nullptr) {
+            grid.attach(*second, 2, line, 1, 1);
+        }
+        line++;
+    };
+
+    Gtk::ComboBoxText type;
+    type.append("Rings and bombs");
+    type.append("Rings");
+    type.append("Bombs");
+    type.set_active(int(last_query.type));
+    add_line("Objects:", type, nullptr);
+
+    Gtk::ComboBoxText height;
+    height.append("Any height");
+    height.append("In the air");
+    height.append("On the ground");
+    height.set_active(int(last_query.height));
+    add_line("Height:", height, nullptr);
+
+    // Segments are shown counting from 1, as in the segment frame.
+    Gtk::SpinButton first_segment, last_segment;
+    for (auto* spin : {&first_segment, &last_segment}) {
+        spin->set_range(1.0, numsegments);
+        spin->set_increments(1.0, 10.0);
+    }
+    first_segment.set_value(double(last_query.first_segment) + 1.0);
+    last_segment.set_value(
+            last_query.last_segment < currlvl->num_segments()
+                    ? double(last_query.last_segment) + 1.0
+                    : numsegments);
+    add_line("Segments:", first_segment, &last_segment);
+
+    Gtk::SpinButton first_row, last_row;
+    for (auto* spin : {&first_row, &last_row}) {
+        spin->set_range(0.0, double(sssegments::ePositionMask));
+        spin->set_increments(1.0, 8.0);
+    }
+    first_row.set_value(last_query.first_row);
+    last_row.set_value(last_query.last_row);
+    add_line("Rows:", first_row, &last_row);
+
+    Gtk::Entry first_angle, last_angle;
+    first_angle.set_text(angle_to_string(last_query.first_angle));
+    last_angle.set_text(angle_to_string(last_query.last_angle));
+    first_angle.set_tooltip_text(
+            "Angle band; it wraps around if the first angle is the larger");
+    last_angle.set_activates_default(true);
+    add_line("Angles:", first_angle, &last_angle);
+
+    Gtk::CheckButton normal("Normal"), message("Rings message"),
+            checkpoint("Checkpoint"), emerald("Chaos emerald");
+    normal.set_active((last_query.segment_types & object_query::eNormalMask)
+                      != 0);
+    message.set_active(
+            (last_query.segment_types & object_query::eRingsMessageMask) != 0);
+    checkpoint.set_active(
+            (last_query.segment_types & object_query::eCheckpointMask) != 0);
+    emerald.set_active(
+            (last_query.segment_types & object_query::eChaosEmeraldMask) != 0);
+    add_line("Segment types:", normal, &message);
+    grid.attach(checkpoint, 1, line, 1, 1);
+    grid.attach(emerald, 2, line, 1, 1);
+    line++;
+
+    Gtk::ComboBoxText combine;
+    combine.append("Replace selection");
+    combine.append("Add to selection");
+    combine.append("Remove from selection");
+    combine.append("Intersect with selection");
+    combine.set_active(int(query_mode));
+    add_line("Result:", combine, nullptr);
+
+    dialog.get_content_area()->pack_start(grid);
+    dialog.show_all();
+    if (dialog.run() != Gtk::RESPONSE_OK) {
+        return;
+    }
+
+    object_query query;
+    if (!parse_angle(first_angle.get_text(), query.first_angle)
+        || !parse_angle(last_angle.get_text(), query.last_angle)) {
+        Gtk::MessageDialog error(
+                *main_win, "Angles must be numbers from 0 to 255 (0xff).",
+                false, Gtk::MESSAGE_ERROR);
+        error.run();
+        return;
+    }
+    query.type   = object_query::TypeFilter(type.get_active_row_number());
+    query.height = object_query::HeightFilter(height.get_active_row_number());
+    query.first_segment = size_t(first_segment.get_value_as_int() - 1);
+    query.last_segment  = size_t(last_segment.get_value_as_int() - 1);
+    query.first_row     = static_cast<uint8_t>(first_row.get_value_as_int());
+    query.last_row      = static_cast<uint8_t>(last_row.get_value_as_int());
+    unsigned types = 0;
+    for (auto const& elem :
+         {std::make_pair(&normal, object_query::eNormalMask),
+          std::make_pair(&message, object_query::eRingsMessageMask),
+          std::make_pair(&checkpoint, object_query::eCheckpointMask),
+          std::make_pair(&emerald, object_query::eChaosEmeraldMask)}) {
+        if (elem.first->get_active()) {
+            types |= elem.second;
+        }
+    }
+    query.segment_types = static_cast<uint8_t>(types);
+    last_query = query;
+    query_mode = QueryModes(combine.get_active_row_number());
+
+    object_set found = query.run(*currlvl);
+    switch (query_mode) {
+    case eReplaceSelection:
+        selection.swap(found);
+        break;
+    case eAddToSelection:
+        selection.unite(found);
+        break;
+    case eRemoveFromSelection:
+        selection.subtract(found);
+        break;
+    case eIntersectSelection:
+        selection.intersect(found);
+        break;
+    }
+    hotstack.clear();
+
+    // Bring the first selected object into view if it is off screen.
+    if (!selection.empty()) {
+        int pos = get_obj_pos<int>(*selection.begin());
+        int top = get_scroll();
+        if (pos < top || pos >= top + draw_height / SIMAGE_SIZE) {
+            pvscrollbar->set_value(pos);
+        }
+    }
+    update();
+}
@@ -18,14 +18,21 @@
 
 #include "s2ssedit/sseditor.hh"
 
+#include <algorithm>
 #include <cassert>
 #include <fstream>
+#include <iomanip>
+#include <sstream>
 
+using std::fixed;
 using std::ifstream;
 using std::ios;
 using std::make_shared;
-using std::shared_ptr;
+using std::min;
+using std::ostringstream;
+using std::setprecision;
 using std::string;
+using std::to_string;
 
 void sseditor::on_vscrollbar_value_changed() {
     if (update_in_progress) {
@@ -49,12 +56,14 @@ void sseditor::on_filedialog_response(int response_id) {
         fobj.close();
         flay.close();
         specialstages = make_shared<ssobj_file>(dirname);
-        undostack.clear();
-        redostack.clear();
+        project_dir   = dirname;
+        history.clear();
         selection.clear();
         hotstack.clear();
         insertstack.clear();
         sourcestack.clear();
+        stages_dirty = true;
+        open_journal();
         currstage = currsegment = 0;
         update_segment_positions(true);
         update();
@@ -62,6 +71,34 @@ void sseditor::on_filedialog_response(int response_id) {
     filedlg->hide();
 }
 
+void sseditor::open_journal() {
+    size_t const edits = edit_journal::pending_edits(project_dir);
+    bool         keep  = false;
+    if (edits != 0) {
+        Gtk::MessageDialog dialog(
+                *main_win, "Recover unsaved edits?", false,
+                Gtk::MESSAGE_QUESTION, Gtk::BUTTONS_YES_NO);
+        dialog.set_secondary_text(
+                "The last session left " + to_string(edits)
+                + " unsaved edits to this project. Replay them onto the "
+                  "saved files?");
+        keep = dialog.run() == Gtk::RESPONSE_YES
+               && edit_journal::replay(project_dir, specialstages) != 0;
+    }
+    journal.open(project_dir, keep);
+}
+
+void sseditor::report_journal_error() {
+    Gtk::MessageDialog dialog(
+            *main_win, "Edits are no longer being logged", false,
+            Gtk::MESSAGE_WARNING);
+    dialog.set_secondary_text(
+            "Could not write the edit journal in '" + project_dir
+            + "'. Edits made from now on cannot be recovered if the editor "
+              "stops; save the project to keep them.");
+    dialog.run();
+}
+
 void sseditor::on_helpdialog_response(int response_id) {
     ignore_unused_variable_warning(response_id);
     helpdlg->hide();
@@ -86,27 +123,47 @@ void sseditor::on_openfilebutton_clicked() {
 
 void sseditor::on_savefilebutton_clicked() {
     specialstages->write();
+    // Edits so far are saved; start over against the new files.
+    journal.open(project_dir);
     update();
 }
 
 void sseditor::on_revertfilebutton_clicked() {
-    undostack.clear();
-    redostack.clear();
+    history.clear();
     selection.clear();
     hotstack.clear();
     insertstack.clear();
     sourcestack.clear();
     specialstages->read();
+    stages_dirty = true;
+    journal.open(project_dir);
     currstage = currsegment = 0;
     update_segment_positions(true);
     update();
 }
 
+void sseditor::commit_edits() {
+    history.commit();
+    if (history.in_transaction()) {
+        return;
+    }
+
+    if (currstage >= specialstages->num_stages()) {
+        currstage = specialstages->num_stages() - 1;
+    }
+    update_segment_positions(false);
+    if (currsegment >= segpos.size()) {
+        goto_segment(segpos.size() - 1);
+    }
+
+    update();
+}
+
 void sseditor::on_undobutton_clicked() {
-    shared_ptr<abstract_action> act = undostack.front();
-    undostack.pop_front();
-    redostack.push_front(act);
-    act->revert(specialstages, &selection);
+    if (!history.undo(specialstages, &selection)) {
+        return;
+    }
+    stages_dirty = true;
     if (mode != eSelectMode) {
         selection.clear();
     }
@@ -123,10 +180,10 @@ void sseditor::on_undobutton_clicked() {
 }
 
 void sseditor::on_redobutton_clicked() {
-    shared_ptr<abstract_action> act = redostack.front();
-    redostack.pop_front();
-    undostack.push_front(act);
-    act->apply(specialstages, &selection);
+    if (!history.redo(specialstages, &selection)) {
+        return;
+    }
+    stages_dirty = true;
     if (mode != eSelectMode) {
         selection.clear();
     }
@@ -142,6 +199,109 @@ void sseditor::on_redobutton_clicked() {
     update();
 }
 
+static string format_bytes(size_t bytes) {
+    constexpr const double kibibyte = 1024.0;
+    ostringstream          out;
+    out << fixed << setprecision(1);
+    if (bytes < 1024U * 1024U) {
+        out << double(bytes) / kibibyte << " KiB";
+    } else {
+        out << double(bytes) / (kibibyte * kibibyte) << " MiB";
+    }
+    return out.str();
+}
+
+void sseditor::update_undo_label() {
+    plabelundo->set_label(
+            to_string(history.undo_steps()) + " steps, "
+            + format_bytes(history.memory_usage()));
+    undo_history::limits const& lim = history.get_limits();
+    string tip = "Memory used by the undo history; budget: ";
+    tip += lim.max_bytes != 0 ? format_bytes(lim.max_bytes) : "unlimited";
+    tip += ", ";
+    tip += lim.max_steps != 0 ? to_string(lim.max_steps) + " steps"
+                              : "unlimited steps";
+    if (lim.compact) {
+        tip += ", compacting old edits";
+    }
+    plabelundo->set_tooltip_text(tip);
+}
+
+static string format_totals(stage_stats::totals const& sum) {
+    return to_string(sum.rings) + " rings, " + to_string(sum.bombs)
+           + " bombs, " + to_string(sum.shadows) + " shadows";
+}
+
+static string interval_name(stage_stats::interval const& iv, size_t number) {
+    switch (iv.end) {
+    case sssegments::eCheckpoint:
+        return "Checkpoint " + to_string(number + 1);
+    case sssegments::eChaosEmerald:
+        return "Emerald";
+    case sssegments::eNormalSegment:
+    case sssegments::eRingsMessage:
+        break;
+    }
+    return "Stage end";
+}
+
+void sseditor::update_stage_totals() {
+    if (!specialstages || currstage >= specialstages->num_stages()) {
+        if (totals_stage == ~0U && !stages_dirty) {
+            return;
+        }
+        stats.clear();
+        plabelstagetotals->set_markup("<b>Stage:</b> " + format_totals({}));
+        plabelcheckpointtotals->set_markup(
+                "<b>Checkpoint:</b> " + format_totals({}));
+        plabelcheckpointtotals->set_tooltip_text("");
+        totals_stage = ~0U;
+        return;
+    }
+    // Only the segments changed since the last update are added again, and
+    // only after a change or when another stage is shown.
+    stats.resize(specialstages->num_stages());
+    stage_stats& curr    = stats[currstage];
+    bool         changed = currstage != totals_stage;
+    if (stages_dirty || changed) {
+        changed = curr.update(*specialstages->get_stage(currstage)) || changed;
+    }
+    totals_stage = currstage;
+    size_t                number = 0;
+    stage_stats::interval iv{};
+    if (curr.size() != 0) {
+        iv = curr.get_interval(
+                min(size_t(currsegment), curr.size() - 1), number);
+    }
+    if (!changed && number == totals_interval) {
+        return;
+    }
+    totals_interval = number;
+
+    plabelstagetotals->set_markup(
+            "<b>Stage:</b> " + format_totals(curr.stage_totals()));
+    if (curr.size() == 0) {
+        plabelcheckpointtotals->set_markup(
+                "<b>Checkpoint:</b> " + format_totals({}));
+        plabelcheckpointtotals->set_tooltip_text("");
+        return;
+    }
+    plabelcheckpointtotals->set_markup(
+            "<b>" + interval_name(iv, number) + ":</b> "
+            + format_totals(iv.sum));
+    string tip;
+    number = 0;
+    for (auto const& elem : curr.get_intervals()) {
+        if (!tip.empty()) {
+            tip += '\n';
+        }
+        tip += interval_name(elem, number++) + " (segments "
+               + to_string(elem.first + 1) + "-" + to_string(elem.last + 1)
+               + "): " + format_totals(elem.sum);
+    }
+    plabelcheckpointtotals->set_tooltip_text(tip);
+}
+
 void sseditor::on_helpbutton_clicked() {
     if (helpdlg == nullptr) {
         builder->get_widget("helpdialog", helpdlg);
@@ -169,39 +329,21 @@ void sseditor::on_quitbutton_clicked() {
 }
 
 void sseditor::on_cutbutton_clicked() {
-    copystack = selection;
-    copypos   = get_scroll();
-    do_action<cut_selection_action>(currstage, copystack);
+    copy_selection();
+    do_action<cut_selection_action>(currstage, selection);
     selection.clear();
     update();
 }
 
 void sseditor::on_copybutton_clicked() {
-    copystack = selection;
-    copypos   = get_scroll();
+    copy_selection();
     update();
 }
 
 void sseditor::on_pastebutton_clicked() {
-    int maxpos = endpos - 1;
-    int delta  = get_scroll() - copypos;
-
-    selection.clear();
-    for (auto const& elem : copystack) {
-        int newpos = delta + get_obj_pos<int>(elem);
-        if (newpos < 0) {
-            newpos = 0;
-        } else if (newpos > maxpos) {
-            newpos = maxpos;
-        }
-
-        int newseg = static_cast<int>(find_segment(newpos));
-        int newy   = newpos - segpos[newseg];
-        selection.emplace(newseg, elem.get_angle(), newy, elem.get_type());
+    if (!paste_from_clipboard(object_payload::eObjectRows)) {
+        paste_objects(copyrows);
     }
-
-    do_action<paste_objects_action>(currstage, selection);
-    update();
 }
 
 void sseditor::on_deletebutton_clicked() {
@@ -271,6 +413,7 @@ void sseditor::on_append_stage_button_clicked() {
 void sseditor::on_cut_stage_button_clicked() {
     sslevels* lev = specialstages->get_stage(currstage);
     copylevel     = make_shared<sslevels>(*lev);
+    publish_clipboard(object_payload::eStage);
     do_action<delete_stage_action>(currstage, *copylevel);
     if (currstage >= specialstages->num_stages()) {
         currstage = specialstages->num_stages() - 1;
@@ -285,20 +428,15 @@ void sseditor::on_cut_stage_button_clicked() {
 void sseditor::on_copy_stage_button_clicked() {
     sslevels* lev = specialstages->get_stage(currstage);
     copylevel     = make_shared<sslevels>(*lev);
+    publish_clipboard(object_payload::eStage);
 
     update();
 }
 
 void sseditor::on_paste_stage_button_clicked() {
-    do_action<paste_stage_action>(++currstage, *copylevel);
-    if (currstage >= specialstages->num_stages()) {
-        currstage = specialstages->num_stages() - 1;
-    }
-    update_segment_positions(false);
-    if (currsegment >= segpos.size()) {
-        goto_segment(segpos.size() - 1);
+    if (!paste_from_clipboard(object_payload::eStage) && copylevel) {
+        paste_stage(*copylevel);
     }
-    update();
 }
 
 void sseditor::on_delete_stage_button_clicked() {
@@ -380,6 +518,7 @@ void sseditor::on_cut_segment_button_clicked() {
     sssegments* seg
             = specialstages->get_stage(currstage)->get_segment(currsegment);
     copyseg = make_shared<sssegments>(*seg);
+    publish_clipboard(object_payload::eSegment);
     do_action<cut_segment_action>(currstage, currsegment, *copyseg);
     update_segment_positions(false);
     if (currsegment >= segpos.size()) {
@@ -392,17 +531,15 @@ void sseditor::on_copy_segment_button_clicked() {
     sssegments* seg
             = specialstages->get_stage(currstage)->get_segment(currsegment);
     copyseg = make_shared<sssegments>(*seg);
+    publish_clipboard(object_payload::eSegment);
 
     update();
 }
 
 void sseditor::on_paste_segment_button_clicked() {
-    do_action<paste_segment_action>(currstage, currsegment, *copyseg);
-    update_segment_positions(false);
-    if (currsegment >= segpos.size()) {
-        goto_segment(segpos.size() - 1);
+    if (!paste_from_clipboard(object_payload::eSegment) && copyseg) {
+        paste_segment(*copyseg);
     }
-    update();
 }
 
 void sseditor::on_delete_segment_button_clicked() {
@@ -0,0 +1,147 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) Flamewing 2011-2019 <flamewing.sonic@gmail.com>
+ *
+ * S2-SSEdit is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * S2-SSEdit is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "s2ssedit/spatialindex.hh"
+
+#include "s2ssedit/ssrenderer.hh"
+
+#include <algorithm>
+
+using std::fill;
+using std::max;
+using std::min;
+
+bool spatial_index::same_layout(sslevels const& stage) const noexcept {
+    size_t const numsegments = stage.num_segments();
+    if (revisions.size() != numsegments) {
+        return false;
+    }
+    for (size_t seg = 0; seg < numsegments; seg++) {
+        size_t length = size_t(stage.get_segment(seg)->get_length());
+        if (segstart[seg + 1] - segstart[seg] != length) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void spatial_index::relayout(sslevels const& stage) {
+    std::vector<int> segpos;
+    size_t const     numrows     = stage.fill_position_array(segpos);
+    size_t const     numsegments = segpos.size();
+
+    segstart.assign(segpos.cbegin(), segpos.cend());
+    segstart.push_back(numrows);
+    row_segment.resize(numrows);
+    for (size_t seg = 0; seg < numsegments; seg++) {
+        fill(row_segment.begin() + long(segstart[seg]),
+             row_segment.begin() + long(segstart[seg + 1]),
+             static_cast<uint16_t>(seg));
+    }
+    cells.assign(numrows * cells_per_row, cell{});
+    revisions.resize(numsegments);
+    for (size_t seg = 0; seg < numsegments; seg++) {
+        fill_segment(*stage.get_segment(seg), seg);
+    }
+}
+
+void spatial_index::fill_segment(sssegments const& seg, size_t index) {
+    size_t const first  = segstart[index];
+    size_t const length = segstart[index + 1] - first;
+    auto const   begin  = cells.begin() + long(first * cells_per_row);
+    fill(begin, begin + long(length * cells_per_row), cell{});
+
+    // Rows past the end of the segment belong to the next one, so objects
+    // there can't be picked.
+    for (auto const& row : seg.get_objects()) {
+        if (row.first >= length) {
+            break;
+        }
+        size_t const base = (first + row.first) * cells_per_row;
+        for (auto const& elem : row.second) {
+            cell&         curr = cells[base + elem.first / angles_per_cell];
+            uint8_t const bit  = static_cast<uint8_t>(
+                    1U << (elem.first % angles_per_cell));
+            curr.occupied |= bit;
+            if (elem.second == sssegments::eBomb) {
+                curr.bombs |= bit;
+            }
+        }
+    }
+    revisions[index] = seg.get_revision();
+}
+
+void spatial_index::sync(sslevels const& stage) {
+    if (!same_layout(stage)) {
+        relayout(stage);
+        return;
+    }
+    for (size_t seg = 0; seg < revisions.size(); seg++) {
+        sssegments const& curr = *stage.get_segment(seg);
+        if (revisions[seg] != curr.get_revision()) {
+            fill_segment(curr, seg);
+        }
+    }
+}
+
+void spatial_index::clear() noexcept {
+    cells.clear();
+    segstart.clear();
+    row_segment.clear();
+    revisions.clear();
+}
+
+object spatial_index::hit_test(int x, int y) const noexcept {
+    if (y < 0 || size_t(y / SIMAGE_SIZE) >= row_segment.size()) {
+        return object();
+    }
+    size_t const row = size_t(y / SIMAGE_SIZE);
+
+    // Objects are drawn IMAGE_SIZE pixels wide, two pixels per angle, so at
+    // most IMAGE_SIZE / 2 + 1 screen columns of angles can cover x.
+    constexpr const int span   = int(IMAGE_SIZE) / 2;
+    int const           column = (x - angle_to_x(-center_x)) / 2;
+    int const           first  = max(0, column - span);
+    int const           last   = min(255, column + span);
+
+    int best = -1;
+    for (int col = first; col <= last; col++) {
+        int const angle = (col - center_x) & 0xff;
+        int const tx    = angle_to_x(angle) - HALF_IMAGE_SIZE;
+        if (x < tx || x >= tx + int(IMAGE_SIZE)) {
+            continue;
+        }
+        unsigned const bit  = unsigned(angle) % angles_per_cell;
+        cell const&    curr = cells
+                [row * cells_per_row + unsigned(angle) / angles_per_cell];
+        if (((curr.occupied >> bit) & 1U) != 0 && (best < 0 || angle < best)) {
+            best = angle;
+        }
+    }
+    if (best < 0) {
+        return object();
+    }
+    size_t const   seg  = row_segment[row];
+    unsigned const bit  = unsigned(best) % angles_per_cell;
+    cell const&    curr
+            = cells[row * cells_per_row + unsigned(best) / angles_per_cell];
+    bool const bomb = ((curr.bombs >> bit) & 1U) != 0;
+    return object(
+            int(seg), unsigned(best), unsigned(row - segstart[seg]),
+            bomb ? sssegments::eBomb : sssegments::eRing);
+}
@@ -0,0 +1,118 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) Flamewing 2011-2019 <flamewing.sonic@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "s2ssedit/spriteload.hh"
+
+#include <algorithm>
+
+using std::min;
+using std::vector;
+
+void sprite_load::fill_rows(sssegments const& seg, size_t start) {
+    auto const len = size_t(seg.get_length());
+    std::fill_n(rows.begin() + start, len, counts{});
+    for (auto const& row : seg.get_objects()) {
+        // Rows past the end of the segment are not shown.
+        if (row.first >= len) {
+            break;
+        }
+        counts& cnt = rows[start + row.first];
+        for (auto const& elem : row.second) {
+            if (elem.second == sssegments::eBomb) {
+                cnt.bombs++;
+            } else {
+                cnt.rings++;
+            }
+            if (!sssegments::is_aerial(elem.first)) {
+                cnt.shadows++;
+            }
+        }
+    }
+}
+
+void sprite_load::sum_windows(size_t first, size_t last) {
+    // Running sum: each window is the previous one, minus the row that
+    // leaves it and plus the row that enters it.
+    size_t const count = rows.size();
+    auto const   span  = size_t(depth);
+    counts       sum;
+    for (size_t ii = first; ii < min(first + span, count); ii++) {
+        sum += rows[ii];
+    }
+    for (size_t ii = first; ii < last; ii++) {
+        windows[ii] = sum;
+        sum -= rows[ii];
+        if (ii + span < count) {
+            sum += rows[ii + span];
+        }
+    }
+}
+
+bool sprite_load::update(sslevels const& stage) {
+    vector<int>  newpos;
+    size_t const count    = stage.fill_position_array(newpos);
+    size_t const segments = newpos.size();
+    // The starts and the total fix the length of every segment; a full
+    // rebuild is needed if any of them moved.
+    if (newpos != segpos || count != rows.size()) {
+        segpos.swap(newpos);
+        revisions.resize(segments);
+        rows.assign(count, counts{});
+        windows.assign(count, counts{});
+        for (size_t ii = 0; ii < segments; ii++) {
+            sssegments const* seg = stage.get_segment(ii);
+            revisions[ii]         = seg->get_revision();
+            fill_rows(*seg, size_t(segpos[ii]));
+        }
+        sum_windows(0, count);
+        return true;
+    }
+
+    // A changed segment affects the windows that reach into it, which
+    // start up to depth - 1 rows before it. Spans of adjacent changes are
+    // merged, so each window is summed at most once.
+    auto const span    = size_t(depth);
+    bool       changed = false;
+    size_t     first   = 0;
+    size_t     last    = 0;
+    for (size_t ii = 0; ii < segments; ii++) {
+        sssegments const* seg = stage.get_segment(ii);
+        if (seg->get_revision() == revisions[ii]) {
+            continue;
+        }
+        revisions[ii]    = seg->get_revision();
+        auto const start = size_t(segpos[ii]);
+        auto const end   = start + size_t(seg->get_length());
+        auto const reach = start + 1 > span ? start + 1 - span : 0;
+        fill_rows(*seg, start);
+        if (changed && reach <= last) {
+            last = end;
+            continue;
+        }
+        if (changed) {
+            sum_windows(first, last);
+        }
+        changed = true;
+        first   = reach;
+        last    = end;
+    }
+    if (changed) {
+        sum_windows(first, last);
+    }
+    return changed;
+}
@@ -22,15 +22,13 @@
 
 #include <gdkmm/rgba.h>
 
+#include <fstream>
 #include <iostream>
-#include <set>
-#include <vector>
 
+using std::cerr;
 using std::cout;
 using std::endl;
-using std::set;
 using std::swap;
-using std::vector;
 
 size_t sseditor::get_current_segment() const {
     auto pos = size_t(pvscrollbar->get_value());
@@ -58,6 +56,8 @@ void sseditor::update_segment_positions(bool setpos) {
     constexpr const double page_incr    = 32.0;
     auto                   start_pos    = draw_height / IMAGE_SIZE;
     endpos = specialstages->get_stage(currstage)->fill_position_array(segpos);
+    // Placed insert shapes depend on the segment layout.
+    shape.submode = eNumInsertModes;
     cout << endpos << "\t" << segpos.back() << "\t" << start_pos << endl;
     pvscrollbar->set_range(
             0.0, static_cast<double>(endpos) + range_offset - start_pos);
@@ -72,7 +72,10 @@ bool sseditor::move_object(int dx, int dy) {
         return true;
     }
 
-    set<object> temp;
+    object_set          temp;
+    object_set          moved;
+    std::vector<object> dests;
+    dests.reserve(selection.size());
 
     for (auto const& elem : selection) {
         int  oldseg = elem.get_segment();
@@ -92,8 +95,7 @@ bool sseditor::move_object(int dx, int dy) {
 
         ObjectTypes type;
         while (cnt > 0 && currseg->exists(newy, newx, type)
-               && selection.find(object(oldseg, newx, newy, type))
-                          == selection.end()) {
+               && !is_selected(object(oldseg, newx, newy, type))) {
             newx = static_cast<int8_t>(newx + dx);
             newy += dy;
             newy %= max_y;
@@ -108,9 +110,12 @@ bool sseditor::move_object(int dx, int dy) {
         }
 
         temp.emplace(elem.get_segment(), newx, newy, elem.get_type());
+        // Selection is sorted, so this appends.
+        moved.insert(elem);
+        dests.emplace_back(elem.get_segment(), newx, newy, elem.get_type());
     }
 
-    do_action<move_objects_action>(currstage, selection, temp);
+    do_action<shift_objects_action>(currstage, std::move(moved), dests);
     selection.swap(temp);
     update();
     return true;
@@ -123,211 +128,39 @@ void sseditor::cleanup_render(Cairo::RefPtr<Cairo::Context> const& cr) {
     drawimg = cr->pop_group();
 }
 
-void sseditor::draw_objects(
-        Cairo::RefPtr<Cairo::Context> const& cr, int start, int end) {
-    for (int i = start; i <= end; i++) {
-        int         seg     = find_segment(i);
-        sssegments* currseg = get_segment(seg);
-        if (currseg == nullptr) {
-            return;
-        }
-
-        auto const& row = currseg->get_row(i - segpos[seg]);
-        for (auto const& elem : row) {
-            Glib::RefPtr<Gdk::Pixbuf> image
-                    = (elem.second == sssegments::eBomb) ? bombimg : ringimg;
-
-            int ty = (i - get_scroll()) * SIMAGE_SIZE;
-            int tx = angle_to_x(elem.first) - image->get_width() / 2;
-            Gdk::Cairo::set_source_pixbuf(cr, image, tx, ty);
-            cr->paint();
-        }
-    }
-}
-
-bool sseditor::want_checkerboard(int row, int seg, sssegments* currseg) {
-    return (seg == 2 && (row - segpos[seg] == (currseg->get_length() - 1) / 2))
-           || ((currseg->get_type() == sssegments::eCheckpoint
-                || currseg->get_type() == sssegments::eChaosEmerald)
-               && (row - segpos[seg]) == currseg->get_length() - 1);
-}
-
-struct RGB {
-    double red;
-    double green;
-    double blue;
-    constexpr RGB(uint8_t r, uint8_t g, uint8_t b)
-            : red(r / 255.0), green(g / 255.0), blue(b / 255.0) {}
-};
-
-void sseditor::draw_balls(
-        Cairo::RefPtr<Cairo::Context> const& cr, int ty) const {
-    // TODO: Read palettes and use colors.
-    static constexpr const std::array<RGB, 7> hilites{
-            RGB{255, 172, 52}, RGB{255, 144, 0}, RGB{255, 172, 52},
-            RGB{255, 172, 52}, RGB{0, 255, 87},  RGB{255, 172, 52},
-            RGB{172, 172, 206}};
-    static constexpr const std::array<RGB, 7> midtones{
-            RGB{206, 144, 52}, RGB{206, 116, 0}, RGB{206, 144, 52},
-            RGB{206, 144, 52}, RGB{0, 172, 52},  RGB{206, 144, 52},
-            RGB{144, 144, 172}};
-    static constexpr const std::array<RGB, 7> shadows{
-            RGB{172, 116, 52}, RGB{172, 87, 0}, RGB{172, 116, 52},
-            RGB{172, 116, 52}, RGB{0, 144, 0},  RGB{172, 116, 52},
-            RGB{116, 116, 144}};
-    const auto hilite  = hilites[currstage % hilites.size()];
-    const auto midtone = midtones[currstage % midtones.size()];
-    const auto shadow  = shadows[currstage % shadows.size()];
-    for (int iangle = 0; iangle < 3; iangle++) {
-        double angle  = (iangle * 64.0) / 3.0;
-        int    mangle = static_cast<int>(angle);
-        cr->set_source_rgb(shadow.red, shadow.green, shadow.blue);
-        cr->arc(angle_to_x(mangle + 0x80) + HALF_IMAGE_SIZE, ty,
-                HALF_IMAGE_SIZE, 0.0, 2.0 * G_PI);
-        cr->begin_new_sub_path();
-        cr->arc(angle_to_x(0x00 - mangle) - HALF_IMAGE_SIZE, ty,
-                HALF_IMAGE_SIZE, 0.0, 2.0 * G_PI);
-        cr->fill();
-        cr->set_source_rgb(midtone.red, midtone.green, midtone.blue);
-        cr->arc(angle_to_x(mangle + 0x80) + HALF_IMAGE_SIZE, ty - 1.5,
-                HALF_IMAGE_SIZE - 2, 0.0, 2.0 * G_PI);
-        cr->begin_new_sub_path();
-        cr->arc(angle_to_x(0x00 - mangle) - HALF_IMAGE_SIZE, ty - 1.5,
-                HALF_IMAGE_SIZE - 2, 0.0, 2.0 * G_PI);
-        cr->fill();
-        cr->set_source_rgb(hilite.red, hilite.green, hilite.blue);
-        cr->arc(angle_to_x(mangle + 0x80) + HALF_IMAGE_SIZE, ty - 3.0,
-                HALF_IMAGE_SIZE - 4, 0.0, 2.0 * G_PI);
-        cr->begin_new_sub_path();
-        cr->arc(angle_to_x(0x00 - mangle) - HALF_IMAGE_SIZE, ty - 3.0,
-                HALF_IMAGE_SIZE - 4, 0.0, 2.0 * G_PI);
-        cr->fill();
-    }
-}
-
 bool sseditor::on_specialstageobjs_expose_event(
         const Cairo::RefPtr<Cairo::Context>& cr) {
-    // TODO: Read palettes and use colors.
-    static constexpr const std::array<RGB, 7> fgcolors{
-            RGB{0, 172, 206},   RGB{206, 0, 144}, RGB{206, 87, 0},
-            RGB{206, 206, 172}, RGB{255, 144, 0}, RGB{116, 172, 0},
-            RGB{144, 144, 144}};
-    static constexpr const std::array<RGB, 7> lanecolors{
-            RGB{255, 172, 52}, RGB{255, 144, 0}, RGB{255, 172, 52},
-            RGB{255, 172, 52}, RGB{0, 255, 87},  RGB{255, 172, 52},
-            RGB{172, 172, 206}};
-    // Base tube color
-    const auto fgcolor = fgcolors[currstage % fgcolors.size()];
-    cr->set_source_rgb(fgcolor.red, fgcolor.green, fgcolor.blue);
-    cr->paint();
-
     if (!specialstages) {
+        renderer->set_stage(nullptr, currstage);
+        renderer->draw_background(cr, draw_width, draw_height);
         return true;
     }
 
-    int start    = get_scroll();
-    int end      = start + (draw_height + SIMAGE_SIZE - 1) / SIMAGE_SIZE;
-    int last_seg = -1;
-
-    // Draw area outside of the tube (left)
-    // const auto bgcolor = bgcolors[currstage % bgcolors.size()];
-    constexpr const auto bgcolor = RGB(0, 87, 116);
-    cr->set_source_rgb(bgcolor.red, bgcolor.green, bgcolor.blue);
-    cr->rectangle(0.0, 0.0, angle_to_x(0x00), draw_height);
-    cr->fill();
-
-    // Draw area outside of the tube (right)
-    cr->rectangle(
-            angle_to_x(0x80), 0.0, draw_width - angle_to_x(0x80), draw_height);
-    cr->fill();
-
-    cr->set_line_width(8.0);
-    const auto lanecolor = lanecolors[currstage % lanecolors.size()];
-    cr->set_source_rgb(lanecolor.red, lanecolor.green, lanecolor.blue);
-    cr->move_to(angle_to_x(0x00 - 2), 0.0);
-    cr->line_to(angle_to_x(0x00 - 2), draw_height);
-    cr->move_to(angle_to_x(0x80 + 2), 0.0);
-    cr->line_to(angle_to_x(0x80 + 2), draw_height);
-    cr->stroke();
-
-    cr->set_line_width(16.0);
-    cr->move_to(angle_to_x(0x30 - 4), 0.0);
-    cr->line_to(angle_to_x(0x30 - 4), draw_height);
-    cr->move_to(angle_to_x(0x50 + 4), 0.0);
-    cr->line_to(angle_to_x(0x50 + 4), draw_height);
-    cr->stroke();
-
-    for (int ii = start; ii <= end; ii++) {
-        int         seg     = find_segment(ii);
-        sssegments* currseg = get_segment(seg);
-        if (currseg == nullptr) {
-            break;
-        }
-
-        int ty = (ii - get_scroll()) * SIMAGE_SIZE;
-        if ((ii + 1) % 4 == 0) {
-            cr->set_line_width(HALF_IMAGE_SIZE);
-            cr->set_source_rgb(lanecolor.red, lanecolor.green, lanecolor.blue);
-            // Horizontal beams.
-            cr->move_to(angle_to_x(0x00), ty);
-            cr->line_to(angle_to_x(0x80), ty);
-            cr->stroke();
-            // Horizontal balls.
-            draw_balls(cr, ty);
-            // Yellow beams.
-            cr->set_line_width(QUARTER_IMAGE_SIZE);
-            cr->set_source_rgb(1.0, 1.0, 0.0);
-            cr->move_to(angle_to_x(0x30 - 4), ty - IMAGE_SIZE);
-            cr->line_to(angle_to_x(0x30 - 4), ty + IMAGE_SIZE);
-            cr->move_to(angle_to_x(0x50 + 4), ty - IMAGE_SIZE);
-            cr->line_to(angle_to_x(0x50 + 4), ty + IMAGE_SIZE);
-            cr->move_to(angle_to_x(0x00 - 4), ty - 3 * IMAGE_SIZE);
-            cr->line_to(angle_to_x(0x00 - 4), ty - IMAGE_SIZE);
-            cr->move_to(angle_to_x(0x80 + 4), ty - 3 * IMAGE_SIZE);
-            cr->line_to(angle_to_x(0x80 + 4), ty - IMAGE_SIZE);
-            cr->stroke();
-        }
-
-        if (want_checkerboard(ii, seg, currseg)) {
-            cr->save();
-            cr->set_dash(vector<double>{8.0}, 0.0);
-            cr->set_source_rgb(1.0, 1.0, 1.0);
-            cr->set_line_width(HALF_IMAGE_SIZE);
-            cr->move_to(angle_to_x(0x00), ty - HALF_IMAGE_SIZE);
-            cr->line_to(angle_to_x(0x80), ty - HALF_IMAGE_SIZE);
-            cr->move_to(angle_to_x(0x80), ty);
-            cr->line_to(angle_to_x(0x00), ty);
-            cr->move_to(angle_to_x(0x00), ty + HALF_IMAGE_SIZE);
-            cr->line_to(angle_to_x(0x80), ty + HALF_IMAGE_SIZE);
-            cr->stroke();
-            cr->set_source_rgb(0.0, 0.0, 0.0);
-            cr->set_line_width(HALF_IMAGE_SIZE);
-            cr->move_to(angle_to_x(0x80), ty - HALF_IMAGE_SIZE);
-            cr->line_to(angle_to_x(0x00), ty - HALF_IMAGE_SIZE);
-            cr->move_to(angle_to_x(0x00), ty);
-            cr->line_to(angle_to_x(0x80), ty);
-            cr->move_to(angle_to_x(0x80), ty + HALF_IMAGE_SIZE);
-            cr->line_to(angle_to_x(0x00), ty + HALF_IMAGE_SIZE);
-            cr->stroke();
-            cr->restore();
-        }
+    int start = get_scroll();
+    int end   = start + (draw_height + SIMAGE_SIZE - 1) / SIMAGE_SIZE;
 
-        if (last_seg != seg) {
-            last_seg = seg;
-            cr->set_line_width(4.0);
-            cr->set_source_rgb(1.0, 1.0, 1.0);
-            int my = (segpos[seg] - get_scroll()) * SIMAGE_SIZE;
-            cr->move_to(0, my);
-            cr->line_to(draw_width, my);
-            cr->stroke();
-        }
+    if (profile) {
+        profile->begin_frame();
     }
+    renderer->set_stage(specialstages->get_stage(currstage), currstage);
+    renderer->draw_background(cr, draw_width, draw_height);
+    renderer->draw_rows(cr, start, end, start, draw_width);
+    draw_overlays(cr);
+    renderer->draw_objects(cr, start, end, start);
+    if (profile) {
+        profile->end_frame();
+        profile->draw(cr, HALF_IMAGE_SIZE, HALF_IMAGE_SIZE);
+    }
+    return true;
+}
 
+void sseditor::draw_overlays(Cairo::RefPtr<Cairo::Context> const& cr) {
+    render_profile::scope timer(profile.get(), render_profile::eOverlays);
     if (mode == eSelectMode) {
         cr->set_source_rgb(0.0, 0.0, 0.0);
         cr->set_line_width(2.0);
-        draw_outlines(selection, hotstack, cr);
-        draw_outlines(hotstack, selection, cr);
+        draw_outlines(selection, get_mask(hotstack, hotstack_mask), cr);
+        draw_outlines(hotstack, get_mask(selection, selection_mask), cr);
         if (hotspot.valid()) {
             cr->set_source_rgb(1.0, 1.0, 0.0);
             cr->set_line_width(2.0);
@@ -363,9 +196,6 @@ bool sseditor::on_specialstageobjs_expose_event(
         cr->set_line_width(2.0);
         draw_objects(insertstack, cr);
     }
-
-    draw_objects(cr, start, end);
-    return true;
 }
 
 void sseditor::draw_box(Cairo::RefPtr<Cairo::Context> const& cr) {
@@ -409,30 +239,11 @@ void sseditor::draw_box(Cairo::RefPtr<Cairo::Context> const& cr) {
 
 void sseditor::select_hotspot() {
     hotspot.reset();
-    int start = get_scroll();
-    int end   = start + (draw_height + SIMAGE_SIZE - 1) / SIMAGE_SIZE;
-
-    for (int i = start; i <= end && !hotspot.valid(); i++) {
-        int         seg     = find_segment(i);
-        sssegments* currseg = get_segment(seg);
-        if (currseg == nullptr) {
-            break;
-        }
-
-        auto const& row = currseg->get_row(i - segpos[seg]);
-        for (auto const& elem : row) {
-            int ty = (i - get_scroll()) * SIMAGE_SIZE;
-            int tx = angle_to_x(static_cast<int8_t>(elem.first))
-                     - HALF_IMAGE_SIZE;
-
-            if (mouse_x >= tx && mouse_y >= ty
-                && mouse_x < tx + static_cast<int>(IMAGE_SIZE)
-                && mouse_y < ty + static_cast<int>(IMAGE_SIZE)) {
-                hotspot.set(seg, elem.first, i - segpos[seg], elem.second);
-                break;
-            }
-        }
+    if (currstage >= specialstages->num_stages()) {
+        return;
     }
+    hitgrid.sync(*specialstages->get_stage(currstage));
+    hotspot = hitgrid.hit_test(mouse_x, mouse_y + get_scroll() * SIMAGE_SIZE);
 }
 
 void sseditor::show() {
@@ -499,6 +310,18 @@ bool sseditor::on_specialstageobjs_key_press_event(GdkEventKey* event) {
         show();
         break;
     }
+
+    case GDK_KEY_space:
+        pplaybutton->set_active(!pplaybutton->get_active());
+        break;
+
+    case GDK_KEY_F12:
+        if ((event->state & GDK_SHIFT_MASK) != 0) {
+            save_profile();
+        } else {
+            toggle_profile();
+        }
+        break;
     }
     return true;
 }
@@ -522,12 +345,11 @@ bool sseditor::on_specialstageobjs_button_press_event(GdkEventButton* event) {
     selclear.reset();
     if (mode == eSelectMode) {
         if ((event->state & GDK_CONTROL_MASK) == 0
-            && (!hotspot.valid()
-                || selection.find(hotspot) == selection.end())) {
+            && (!hotspot.valid() || !is_selected(hotspot))) {
             selection.clear();
         }
         if (hotspot.valid()) {
-            if (selection.find(hotspot) == selection.end()) {
+            if (!is_selected(hotspot)) {
                 selection.insert(hotspot);
             } else {
                 selclear = hotspot;
@@ -542,12 +364,12 @@ bool sseditor::on_specialstageobjs_button_press_event(GdkEventButton* event) {
     return true;
 }
 
-void sseditor::delete_set(set<object>& toDel) {
+void sseditor::delete_set(object_set& toDel) {
     do_action<delete_selection_action>(currstage, toDel);
     toDel.clear();
 }
 
-void sseditor::delete_set(set<object>&& toDel) {
+void sseditor::delete_set(object_set&& toDel) {
     do_action<delete_selection_action>(currstage, std::move(toDel));
 }
 
@@ -590,20 +412,13 @@ sssegments* sseditor::get_segment(int seg) {
 }
 
 void sseditor::finalize_selection() {
-    for (auto const& elem : hotstack) {
-        auto it2 = selection.find(elem);
-        if (it2 == selection.end()) {
-            selection.insert(elem);
-        } else {
-            selection.erase(it2);
-        }
-    }
+    selection.toggle(hotstack);
     hotstack.clear();
 }
 
 void sseditor::insert_set() {
     if (!insertstack.empty()) {
-        set<object> delstack;
+        object_set delstack;
         for (auto const& elem : insertstack) {
             int         seg     = elem.get_segment();
             sssegments* currseg = get_segment(seg);
@@ -617,3 +432,33 @@ void sseditor::insert_set() {
         insertstack.clear();
     }
 }
+
+void sseditor::toggle_profile() {
+    if (profile) {
+        profile.reset();
+    } else {
+        profile = std::make_unique<render_profile>();
+    }
+    renderer->set_profile(profile.get());
+    render();
+}
+
+void sseditor::save_profile() {
+    if (!profile || profile->num_frames() == 0) {
+        return;
+    }
+    Gtk::FileChooserDialog dialog(
+            *main_win, "Save render profile", Gtk::FILE_CHOOSER_ACTION_SAVE);
+    dialog.add_button("_Cancel", Gtk::RESPONSE_CANCEL);
+    dialog.add_button("_Save", Gtk::RESPONSE_OK);
+    dialog.set_do_overwrite_confirmation(true);
+    dialog.set_current_name("render-profile.csv");
+    if (dialog.run() != Gtk::RESPONSE_OK) {
+        return;
+    }
+    std::ofstream out(dialog.get_filename(), std::ios::out | std::ios::trunc);
+    profile->write_csv(out);
+    if (!out.good()) {
+        cerr << "Could not write '" << dialog.get_filename() << "'" << endl;
+    }
+}
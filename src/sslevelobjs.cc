@@ -18,6 +18,8 @@
 
 #include "s2ssedit/sslevelobjs.hh"
 
+#include <mdcomp/bigendian_io.hh>
+
 using std::istream;
 using std::ostream;
 
@@ -25,20 +27,48 @@ void sslevels::read(istream& in, istream& lay, int term, int term2) {
     while (in.tellg() < term && lay.tellg() < term2) {
         sssegments nn;
         nn.read(in, lay);
-        segments.push_back(nn);
+        own_segments().push_back(nn);
     }
 }
 
 size_t sslevels::size() const {
     size_t sz = 0;
-    for (auto const& sd : segments) {
+    for (auto const& sd : get_segments()) {
         sz += sd.size();
     }
     return sz;
 }
 
-void sslevels::write(ostream& out, ostream& lay) const {
-    for (auto const& sd : segments) {
-        sd.write(out, lay);
+size_t sslevels::heap_size() const noexcept {
+    if (!segments) {
+        return 0;
+    }
+    size_t total = segments->capacity() * sizeof(sssegments);
+    for (auto const& sd : *segments) {
+        total += sd.heap_size();
+    }
+    return total / size_t(segments.use_count());
+}
+
+void sslevels::write(
+        ostream& out, ostream& lay, sssegments::ObjectOrders order) const {
+    for (auto const& sd : get_segments()) {
+        sd.write(out, lay, order);
+    }
+}
+
+void sslevels::read(istream& in) {
+    size_t const count = BigEndian::Read4(in);
+    for (size_t ii = 0; ii < count && in.good(); ii++) {
+        sssegments nn;
+        nn.read(in);
+        own_segments().push_back(std::move(nn));
+    }
+}
+
+void sslevels::write(ostream& out) const {
+    BigEndian::Write4(out, static_cast<uint32_t>(num_segments()));
+    for (auto const& sd : get_segments()) {
+        sd.write(out);
     }
 }
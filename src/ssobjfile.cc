@@ -128,7 +128,7 @@ void ssobj_file::write() const {
     stringstream objfile(ios::in | ios::out | ios::binary);
     stringstream layfile(ios::in | ios::out | ios::binary);
 
-    write_internal(objfile, layfile);
+    write_internal(objfile, layfile, order);
 
     ofstream fobj(objectfile.c_str(), ios::out | ios::binary);
     ofstream flay(layoutfile.c_str(), ios::out | ios::binary);
@@ -140,7 +140,25 @@ void ssobj_file::write() const {
     nemesis::encode(layfile, flay);
 }
 
-void ssobj_file::write_internal(ostream& objfile, ostream& layfile) const {
+size_t ssobj_file::stored_size() const {
+    ifstream fobj(objectfile.c_str(), ios::in | ios::binary | ios::ate);
+    return fobj.good() ? size_t(fobj.tellg()) : 0;
+}
+
+size_t ssobj_file::compressed_size(sssegments::ObjectOrders ord) const {
+    stringstream objfile(ios::in | ios::out | ios::binary);
+    stringstream layfile(ios::in | ios::out | ios::binary);
+    write_internal(objfile, layfile, ord);
+
+    stringstream packed(ios::in | ios::out | ios::binary);
+    objfile.seekg(0);
+    kosinski::encode(objfile, packed);
+    return packed.str().size();
+}
+
+void ssobj_file::write_internal(
+        ostream& objfile, ostream& layfile,
+        sssegments::ObjectOrders ord) const {
     size_t sz  = 2 * stages.size();
     size_t off = sz;
     for (auto const& sd : stages) {
@@ -150,6 +168,6 @@ void ssobj_file::write_internal(ostream& objfile, ostream& layfile) const {
         off += sd.num_segments();
     }
     for (auto const& sd : stages) {
-        sd.write(objfile, layfile);
+        sd.write(objfile, layfile, ord);
     }
 }
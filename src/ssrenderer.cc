@@ -0,0 +1,350 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) Flamewing 2011-2019 <flamewing.sonic@gmail.com>
+ *
+ * S2-SSEdit is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * S2-SSEdit is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "s2ssedit/ssrenderer.hh"
+
+#include <algorithm>
+#include <array>
+#include <vector>
+
+using std::string;
+using std::upper_bound;
+using std::vector;
+
+struct RGB {
+    double red;
+    double green;
+    double blue;
+    constexpr RGB(uint8_t r, uint8_t g, uint8_t b)
+            : red(r / 255.0), green(g / 255.0), blue(b / 255.0) {}
+};
+
+// Number of distinct stage palettes.
+static constexpr const size_t num_palettes = 7;
+
+// Beam rows are cached as a strip this many pixels above and below the row.
+static constexpr const int strip_above = 3 * SIMAGE_SIZE + QUARTER_IMAGE_SIZE;
+static constexpr const int strip_below = SIMAGE_SIZE + QUARTER_IMAGE_SIZE;
+
+// TODO: Read palettes and use colors.
+static constexpr const std::array<RGB, num_palettes> fgcolors{
+        RGB{0, 172, 206},   RGB{206, 0, 144}, RGB{206, 87, 0},
+        RGB{206, 206, 172}, RGB{255, 144, 0}, RGB{116, 172, 0},
+        RGB{144, 144, 144}};
+static constexpr const std::array<RGB, num_palettes> lanecolors{
+        RGB{255, 172, 52}, RGB{255, 144, 0}, RGB{255, 172, 52},
+        RGB{255, 172, 52}, RGB{0, 255, 87},  RGB{255, 172, 52},
+        RGB{172, 172, 206}};
+
+ssrenderer::ssrenderer(string const& ringfile, string const& bombfile)
+        : ringimg(Cairo::ImageSurface::create_from_png(ringfile)),
+          bombimg(Cairo::ImageSurface::create_from_png(bombfile)) {}
+
+void ssrenderer::set_stage(sslevels const* lvl, unsigned index) {
+    level   = lvl;
+    palette = index % num_palettes;
+    if (level == nullptr) {
+        segpos.clear();
+        endpos = 0;
+    } else {
+        endpos = level->fill_position_array(segpos);
+    }
+}
+
+size_t ssrenderer::find_segment(int row) const {
+    // Rows past the end of the stage belong to the last segment.
+    auto it = upper_bound(segpos.begin(), segpos.end(), row);
+    if (it == segpos.begin()) {
+        return 0;
+    }
+    return size_t(it - segpos.begin()) - 1;
+}
+
+bool ssrenderer::want_checkerboard(
+        int row, size_t seg, sssegments const& currseg) const {
+    return (seg == 2 && (row - segpos[seg] == (currseg.get_length() - 1) / 2))
+           || ((currseg.get_type() == sssegments::eCheckpoint
+                || currseg.get_type() == sssegments::eChaosEmerald)
+               && (row - segpos[seg]) == currseg.get_length() - 1);
+}
+
+void ssrenderer::draw_balls(
+        Cairo::RefPtr<Cairo::Context> const& cr, int ty) const {
+    // TODO: Read palettes and use colors.
+    static constexpr const std::array<RGB, num_palettes> hilites{
+            RGB{255, 172, 52}, RGB{255, 144, 0}, RGB{255, 172, 52},
+            RGB{255, 172, 52}, RGB{0, 255, 87},  RGB{255, 172, 52},
+            RGB{172, 172, 206}};
+    static constexpr const std::array<RGB, num_palettes> midtones{
+            RGB{206, 144, 52}, RGB{206, 116, 0}, RGB{206, 144, 52},
+            RGB{206, 144, 52}, RGB{0, 172, 52},  RGB{206, 144, 52},
+            RGB{144, 144, 172}};
+    static constexpr const std::array<RGB, num_palettes> shadows{
+            RGB{172, 116, 52}, RGB{172, 87, 0}, RGB{172, 116, 52},
+            RGB{172, 116, 52}, RGB{0, 144, 0},  RGB{172, 116, 52},
+            RGB{116, 116, 144}};
+    constexpr const double full_circle = 2.0 * 3.14159265358979323846;
+    const auto             hilite      = hilites[palette];
+    const auto             midtone     = midtones[palette];
+    const auto             shadow      = shadows[palette];
+    for (int iangle = 0; iangle < 3; iangle++) {
+        double angle  = (iangle * 64.0) / 3.0;
+        int    mangle = static_cast<int>(angle);
+        cr->set_source_rgb(shadow.red, shadow.green, shadow.blue);
+        cr->arc(angle_to_x(mangle + 0x80) + HALF_IMAGE_SIZE, ty,
+                HALF_IMAGE_SIZE, 0.0, full_circle);
+        cr->begin_new_sub_path();
+        cr->arc(angle_to_x(0x00 - mangle) - HALF_IMAGE_SIZE, ty,
+                HALF_IMAGE_SIZE, 0.0, full_circle);
+        cr->fill();
+        cr->set_source_rgb(midtone.red, midtone.green, midtone.blue);
+        cr->arc(angle_to_x(mangle + 0x80) + HALF_IMAGE_SIZE, ty - 1.5,
+                HALF_IMAGE_SIZE - 2, 0.0, full_circle);
+        cr->begin_new_sub_path();
+        cr->arc(angle_to_x(0x00 - mangle) - HALF_IMAGE_SIZE, ty - 1.5,
+                HALF_IMAGE_SIZE - 2, 0.0, full_circle);
+        cr->fill();
+        cr->set_source_rgb(hilite.red, hilite.green, hilite.blue);
+        cr->arc(angle_to_x(mangle + 0x80) + HALF_IMAGE_SIZE, ty - 3.0,
+                HALF_IMAGE_SIZE - 4, 0.0, full_circle);
+        cr->begin_new_sub_path();
+        cr->arc(angle_to_x(0x00 - mangle) - HALF_IMAGE_SIZE, ty - 3.0,
+                HALF_IMAGE_SIZE - 4, 0.0, full_circle);
+        cr->fill();
+    }
+}
+
+void ssrenderer::paint_beams(
+        Cairo::RefPtr<Cairo::Context> const& cr, int ty) const {
+    const auto lanecolor = lanecolors[palette];
+    cr->set_line_width(HALF_IMAGE_SIZE);
+    cr->set_source_rgb(lanecolor.red, lanecolor.green, lanecolor.blue);
+    // Horizontal beams.
+    cr->move_to(angle_to_x(0x00), ty);
+    cr->line_to(angle_to_x(0x80), ty);
+    cr->stroke();
+    // Horizontal balls.
+    draw_balls(cr, ty);
+    // Yellow beams.
+    cr->set_line_width(QUARTER_IMAGE_SIZE);
+    cr->set_source_rgb(1.0, 1.0, 0.0);
+    cr->move_to(angle_to_x(0x30 - 4), ty - IMAGE_SIZE);
+    cr->line_to(angle_to_x(0x30 - 4), ty + IMAGE_SIZE);
+    cr->move_to(angle_to_x(0x50 + 4), ty - IMAGE_SIZE);
+    cr->line_to(angle_to_x(0x50 + 4), ty + IMAGE_SIZE);
+    cr->move_to(angle_to_x(0x00 - 4), ty - 3 * IMAGE_SIZE);
+    cr->line_to(angle_to_x(0x00 - 4), ty - IMAGE_SIZE);
+    cr->move_to(angle_to_x(0x80 + 4), ty - 3 * IMAGE_SIZE);
+    cr->line_to(angle_to_x(0x80 + 4), ty - IMAGE_SIZE);
+    cr->stroke();
+}
+
+Cairo::RefPtr<Cairo::ImageSurface> ssrenderer::get_beam_strip(
+        int width) const {
+    width = std::max(width, 1);
+    if (!beam_strip || beam_strip->get_width() != width
+        || strip_palette != palette) {
+        render_profile::scope timer(profile, render_profile::eBalls);
+        beam_strip = Cairo::ImageSurface::create(
+                Cairo::FORMAT_ARGB32, width, strip_above + strip_below);
+        paint_beams(Cairo::Context::create(beam_strip), strip_above);
+        strip_palette = palette;
+    }
+    return beam_strip;
+}
+
+void ssrenderer::draw_background(
+        Cairo::RefPtr<Cairo::Context> const& cr, int width, int height) const {
+    render_profile::scope timer(profile, render_profile::eBackground);
+    bool tube = level != nullptr;
+    width     = std::max(width, 1);
+    height    = std::max(height, 1);
+    if (!background || background->get_width() != width
+        || background->get_height() != height || background_palette != palette
+        || background_tube != tube) {
+        background = Cairo::ImageSurface::create(
+                Cairo::FORMAT_RGB24, width, height);
+        paint_background(Cairo::Context::create(background), width, height);
+        background_palette = palette;
+        background_tube    = tube;
+    }
+    cr->set_source(background, 0.0, 0.0);
+    cr->paint();
+}
+
+void ssrenderer::paint_background(
+        Cairo::RefPtr<Cairo::Context> const& cr, int width, int height) const {
+    // Base tube color
+    const auto fgcolor = fgcolors[palette];
+    cr->set_source_rgb(fgcolor.red, fgcolor.green, fgcolor.blue);
+    cr->paint();
+
+    if (level == nullptr) {
+        return;
+    }
+
+    // Draw area outside of the tube (left)
+    // const auto bgcolor = bgcolors[palette];
+    constexpr const auto bgcolor = RGB(0, 87, 116);
+    cr->set_source_rgb(bgcolor.red, bgcolor.green, bgcolor.blue);
+    cr->rectangle(0.0, 0.0, angle_to_x(0x00), height);
+    cr->fill();
+
+    // Draw area outside of the tube (right)
+    cr->rectangle(angle_to_x(0x80), 0.0, width - angle_to_x(0x80), height);
+    cr->fill();
+
+    cr->set_line_width(8.0);
+    const auto lanecolor = lanecolors[palette];
+    cr->set_source_rgb(lanecolor.red, lanecolor.green, lanecolor.blue);
+    cr->move_to(angle_to_x(0x00 - 2), 0.0);
+    cr->line_to(angle_to_x(0x00 - 2), height);
+    cr->move_to(angle_to_x(0x80 + 2), 0.0);
+    cr->line_to(angle_to_x(0x80 + 2), height);
+    cr->stroke();
+
+    cr->set_line_width(16.0);
+    cr->move_to(angle_to_x(0x30 - 4), 0.0);
+    cr->line_to(angle_to_x(0x30 - 4), height);
+    cr->move_to(angle_to_x(0x50 + 4), 0.0);
+    cr->line_to(angle_to_x(0x50 + 4), height);
+    cr->stroke();
+}
+
+void ssrenderer::draw_rows(
+        Cairo::RefPtr<Cairo::Context> const& cr, int start, int end, int scroll,
+        int width) const {
+    if (level == nullptr || segpos.empty()) {
+        return;
+    }
+
+    render_profile::scope timer(profile, render_profile::eBeams);
+    auto const strip    = get_beam_strip(width);
+    size_t     last_seg = segpos.size();
+    for (int ii = start; ii <= end; ii++) {
+        size_t            seg     = find_segment(ii);
+        sssegments const& currseg = *level->get_segment(seg);
+
+        int ty = (ii - scroll) * SIMAGE_SIZE;
+        if ((ii + 1) % 4 == 0) {
+            cr->set_source(strip, 0.0, ty - strip_above);
+            cr->rectangle(0.0, ty - strip_above, width, strip->get_height());
+            cr->fill();
+        }
+
+        if (want_checkerboard(ii, seg, currseg)) {
+            cr->save();
+            cr->set_dash(vector<double>{8.0}, 0.0);
+            cr->set_source_rgb(1.0, 1.0, 1.0);
+            cr->set_line_width(HALF_IMAGE_SIZE);
+            cr->move_to(angle_to_x(0x00), ty - HALF_IMAGE_SIZE);
+            cr->line_to(angle_to_x(0x80), ty - HALF_IMAGE_SIZE);
+            cr->move_to(angle_to_x(0x80), ty);
+            cr->line_to(angle_to_x(0x00), ty);
+            cr->move_to(angle_to_x(0x00), ty + HALF_IMAGE_SIZE);
+            cr->line_to(angle_to_x(0x80), ty + HALF_IMAGE_SIZE);
+            cr->stroke();
+            cr->set_source_rgb(0.0, 0.0, 0.0);
+            cr->set_line_width(HALF_IMAGE_SIZE);
+            cr->move_to(angle_to_x(0x80), ty - HALF_IMAGE_SIZE);
+            cr->line_to(angle_to_x(0x00), ty - HALF_IMAGE_SIZE);
+            cr->move_to(angle_to_x(0x00), ty);
+            cr->line_to(angle_to_x(0x80), ty);
+            cr->move_to(angle_to_x(0x80), ty + HALF_IMAGE_SIZE);
+            cr->line_to(angle_to_x(0x00), ty + HALF_IMAGE_SIZE);
+            cr->stroke();
+            cr->restore();
+        }
+
+        if (last_seg != seg) {
+            last_seg = seg;
+            cr->set_line_width(4.0);
+            cr->set_source_rgb(1.0, 1.0, 1.0);
+            int my = (segpos[seg] - scroll) * SIMAGE_SIZE;
+            cr->move_to(0, my);
+            cr->line_to(width, my);
+            cr->stroke();
+        }
+    }
+}
+
+void ssrenderer::draw_objects(
+        Cairo::RefPtr<Cairo::Context> const& cr, int start, int end,
+        int scroll) const {
+    if (level == nullptr || segpos.empty()) {
+        return;
+    }
+
+    render_profile::scope timer(profile, render_profile::eObjects);
+    for (int i = start; i <= end; i++) {
+        size_t      seg     = find_segment(i);
+        auto const& objects = level->get_segment(seg)->get_objects();
+        auto        it      = objects.find(i - segpos[seg]);
+        if (it == objects.end()) {
+            continue;
+        }
+
+        int ty = (i - scroll) * SIMAGE_SIZE;
+        for (auto const& elem : it->second) {
+            auto const& image
+                    = (elem.second == sssegments::eBomb) ? bombimg : ringimg;
+            int tx = angle_to_x(elem.first) - image->get_width() / 2;
+            cr->set_source(image, tx, ty);
+            cr->paint();
+        }
+        if (profile != nullptr) {
+            profile->add_objects(it->second.size());
+        }
+    }
+}
+
+void ssrenderer::draw(
+        Cairo::RefPtr<Cairo::Context> const& cr, int scroll, int width,
+        int height) const {
+    int start = scroll;
+    int end   = start + (height + SIMAGE_SIZE - 1) / SIMAGE_SIZE;
+    draw_background(cr, width, height);
+    draw_rows(cr, start, end, scroll, width);
+    draw_objects(cr, start, end, scroll);
+}
+
+Cairo::RefPtr<Cairo::ImageSurface> ssrenderer::render_stage(
+        double scale) const {
+    // Cairo refuses to create image surfaces larger than this.
+    constexpr const int max_size = 32767;
+
+    int const width  = default_width;
+    int const height = std::max(endpos, 1) * SIMAGE_SIZE;
+    scale            = std::min(scale, static_cast<double>(max_size) / height);
+
+    auto surface = Cairo::ImageSurface::create(
+            Cairo::FORMAT_RGB24, static_cast<int>(width * scale),
+            static_cast<int>(height * scale));
+    auto cr = Cairo::Context::create(surface);
+    cr->scale(scale, scale);
+    // The cached background is only worth it for the view; a copy the size
+    // of the whole stage would not even fit in a surface for long stages.
+    {
+        render_profile::scope timer(profile, render_profile::eBackground);
+        paint_background(cr, width, height);
+    }
+    int const end = (height + SIMAGE_SIZE - 1) / SIMAGE_SIZE;
+    draw_rows(cr, 0, end, 0, width);
+    draw_objects(cr, 0, end, 0);
+    return surface;
+}
@@ -20,13 +20,17 @@
 
 #include <mdcomp/bigendian_io.hh>
 
+#include <algorithm>
 #include <cstring>
 #include <iostream>
 
 using std::istream;
 using std::ostream;
 
+std::atomic<uint64_t> sssegments::last_revision{0};
+
 void sssegments::read(istream& in, istream& lay) {
+    touch();
     uint8_t geom = Read1(lay);
     flip         = (geom & eFlipMask) != 0;
     geometry     = static_cast<SegmentGeometry>(geom & eGeomMask);
@@ -50,7 +54,7 @@ void sssegments::read(istream& in, istream& lay) {
             angle = Read1(in);
             break;
         }
-        auto& posobjs = objects[pos];
+        auto& posobjs = own_objects()[pos];
         posobjs.emplace(angle, ObjectTypes(type));
         add_obj(angle, ObjectTypes(type));
     }
@@ -58,21 +62,56 @@ void sssegments::read(istream& in, istream& lay) {
 
 size_t sssegments::size() const {
     size_t sz = 0;    // Terminator
-    for (auto const& elem : objects) {
+    for (auto const& elem : get_objects()) {
         sz += elem.second.size();
     }
     return 2 * sz + 1;
 }
 
-void sssegments::write(ostream& out, ostream& lay) const {
-    for (auto const& elem : objects) {
-        auto const& posobjs = elem.second;
-        uint8_t     pos     = elem.first;
-        for (auto const& posobj : posobjs) {
+size_t sssegments::heap_size() const noexcept {
+    // Each map node holds the value plus the tree links and color.
+    constexpr const size_t node_overhead = 4 * sizeof(void*);
+    constexpr const size_t row_node
+            = node_overhead + sizeof(segobjs::value_type);
+    constexpr const size_t object_node
+            = node_overhead + sizeof(segobjs::mapped_type::value_type);
+    if (!objects) {
+        return 0;
+    }
+    size_t total = 0;
+    for (auto const& elem : *objects) {
+        total += row_node + elem.second.size() * object_node;
+    }
+    return total / size_t(objects.use_count());
+}
+
+void sssegments::write(ostream& out, ostream& lay, ObjectOrders order) const {
+    Write1(lay, get_flip_geom());
+    for (auto const& elem : get_objects()) {
+        auto const& posobjs   = elem.second;
+        uint8_t     pos       = elem.first;
+        auto const  write_obj = [&out, pos](auto const& posobj) {
             Write1(out, (posobj.second) | pos);
             Write1(out, posobj.first);
+        };
+        switch (order) {
+        case eAngleOrder:
+        case eNumObjectOrders:
+            std::for_each(posobjs.cbegin(), posobjs.cend(), write_obj);
+            break;
+        case eReverseAngleOrder:
+            std::for_each(posobjs.crbegin(), posobjs.crend(), write_obj);
+            break;
+        case eRingsFirstOrder:
+            for (auto type : {eRing, eBomb}) {
+                for (auto const& posobj : posobjs) {
+                    if (posobj.second == type) {
+                        write_obj(posobj);
+                    }
+                }
+            }
+            break;
         }
     }
     Write1(out, terminator);
-    Write1(lay, get_flip_geom());
 }
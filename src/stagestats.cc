@@ -0,0 +1,133 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) Flamewing 2011-2019 <flamewing.sonic@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "s2ssedit/stagestats.hh"
+
+#include <iterator>
+
+using std::vector;
+
+namespace {
+    stage_stats::totals segment_totals(sssegments const& seg) noexcept {
+        stage_stats::totals cnt;
+        cnt.rings   = seg.get_numrings();
+        cnt.bombs   = seg.get_numbombs();
+        cnt.shadows = seg.get_numshadows();
+        return cnt;
+    }
+
+    bool ends_interval(sssegments const& seg) noexcept {
+        return seg.get_type() == sssegments::eCheckpoint
+               || seg.get_type() == sssegments::eChaosEmerald;
+    }
+
+    size_t lowest_bit(size_t index) noexcept {
+        return index & (~index + 1);
+    }
+}    // namespace
+
+void stage_stats::add(size_t seg, totals const& delta) noexcept {
+    for (size_t ii = seg + 1; ii < tree.size(); ii += lowest_bit(ii)) {
+        tree[ii] += delta;
+    }
+}
+
+stage_stats::totals stage_stats::prefix(size_t count) const noexcept {
+    totals sum;
+    for (size_t ii = count; ii > 0; ii -= lowest_bit(ii)) {
+        sum += tree[ii];
+    }
+    return sum;
+}
+
+void stage_stats::rebuild(sslevels const& stage) {
+    size_t const count = stage.num_segments();
+    values.resize(count);
+    revisions.resize(count);
+    ends.clear();
+    // Linear construction: each node passes its sum on to its parent.
+    tree.assign(count + 1, totals{});
+    for (size_t ii = 0; ii < count; ii++) {
+        sssegments const* seg = stage.get_segment(ii);
+        values[ii]            = segment_totals(*seg);
+        revisions[ii]         = seg->get_revision();
+        if (ends_interval(*seg)) {
+            ends.emplace_hint(ends.end(), ii, seg->get_type());
+        }
+        tree[ii + 1] += values[ii];
+        size_t const parent = ii + 1 + lowest_bit(ii + 1);
+        if (parent <= count) {
+            tree[parent] += tree[ii + 1];
+        }
+    }
+}
+
+bool stage_stats::update(sslevels const& stage) {
+    size_t const count = stage.num_segments();
+    if (count != values.size()) {
+        rebuild(stage);
+        return true;
+    }
+    bool changed = false;
+    for (size_t ii = 0; ii < count; ii++) {
+        sssegments const* seg = stage.get_segment(ii);
+        if (seg->get_revision() == revisions[ii]) {
+            continue;
+        }
+        revisions[ii]       = seg->get_revision();
+        totals const newval = segment_totals(*seg);
+        totals       delta  = newval;
+        delta -= values[ii];
+        values[ii] = newval;
+        add(ii, delta);
+        if (ends_interval(*seg)) {
+            ends[ii] = seg->get_type();
+        } else {
+            ends.erase(ii);
+        }
+        changed = true;
+    }
+    return changed;
+}
+
+stage_stats::interval stage_stats::get_interval(
+        size_t seg, size_t& number) const {
+    interval result{0, values.size() - 1, sssegments::eNormalSegment, {}};
+    // The first end at or after the segment closes the interval, and the
+    // one before it opens it.
+    auto it = ends.lower_bound(seg);
+    number  = size_t(std::distance(ends.begin(), it));
+    if (it != ends.end()) {
+        result.last = it->first;
+        result.end  = it->second;
+    }
+    if (it != ends.begin()) {
+        result.first = std::prev(it)->first + 1;
+    }
+    result.sum = range(result.first, result.last);
+    return result;
+}
+
+vector<stage_stats::interval> stage_stats::get_intervals() const {
+    vector<interval> result;
+    size_t           number;
+    for (size_t seg = 0; seg < values.size(); seg = result.back().last + 1) {
+        result.push_back(get_interval(seg, number));
+    }
+    return result;
+}
@@ -0,0 +1,175 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) Flamewing 2011-2019 <flamewing.sonic@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "s2ssedit/stagevalidator.hh"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <utility>
+
+using std::ostringstream;
+using std::string;
+using std::unordered_map;
+
+string validation_issue::describe() const {
+    ostringstream out;
+    switch (kind) {
+    case eTooManyObjects:
+        out << value << " objects; more than "
+            << stage_validator::max_safe_num_objs << " may not all be shown";
+        break;
+    case eBadRow:
+        out << (type == sssegments::eBomb ? "Bomb" : "Ring") << " at row "
+            << row << ", angle 0x" << std::hex << std::setw(2)
+            << std::setfill('0') << unsigned(angle)
+            << " is past the end of the segment";
+        break;
+    case eBadGeometry:
+        out << "Unknown segment geometry " << value;
+        break;
+    case eNoCheckpoint:
+        out << "Stage has no checkpoint";
+        break;
+    case eNoEmerald:
+        out << "Stage does not end with a chaos emerald";
+        break;
+    case eUnreachable:
+        out << value << (value == 1 ? " segment comes" : " segments come")
+            << " after the chaos emerald and can't be reached";
+        break;
+    }
+    return out.str();
+}
+
+bool validation_issue::operator==(
+        validation_issue const& other) const noexcept {
+    return kind == other.kind && stage == other.stage
+           && segment == other.segment && row == other.row
+           && angle == other.angle && type == other.type
+           && value == other.value;
+}
+
+stage_validator::issue_list stage_validator::check_segment(
+        sssegments const& seg) {
+    issue_list found;
+    if (seg.get_totalobjs() > max_safe_num_objs) {
+        validation_issue issue;
+        issue.kind  = validation_issue::eTooManyObjects;
+        issue.value = seg.get_totalobjs();
+        found.push_back(issue);
+    }
+    if (seg.get_geometry() > sssegments::eStraightThenTurn) {
+        validation_issue issue;
+        issue.kind  = validation_issue::eBadGeometry;
+        issue.value = seg.get_geometry();
+        found.push_back(issue);
+    }
+    // Rows are also limited by what fits in the position bits of the file.
+    int const length = std::min(
+            seg.get_length(), int32_t(sssegments::ePositionMask) + 1);
+    auto const& objs = seg.get_objects();
+    for (auto it = objs.lower_bound(uint8_t(length)); it != objs.end();
+         ++it) {
+        for (auto const& elem : it->second) {
+            validation_issue issue;
+            issue.kind  = validation_issue::eBadRow;
+            issue.row   = it->first;
+            issue.angle = elem.first;
+            issue.type  = elem.second;
+            found.push_back(issue);
+        }
+    }
+    return found;
+}
+
+bool stage_validator::run(ssobj_file const& file) {
+    // Entries for segments that are gone are dropped by keeping only the
+    // ones used in this run.
+    unordered_map<uint64_t, issue_list> used;
+    issue_list                          found;
+    auto const checks = [&](sssegments const& seg) -> issue_list const& {
+        uint64_t const rev = seg.get_revision();
+        auto           it  = used.find(rev);
+        if (it != used.end()) {
+            return it->second;
+        }
+        auto old = cache.find(rev);
+        if (old != cache.end()) {
+            return used.emplace(rev, std::move(old->second)).first->second;
+        }
+        return used.emplace(rev, check_segment(seg)).first->second;
+    };
+
+    for (size_t ss = 0; ss < file.num_stages(); ss++) {
+        sslevels const* stage       = file.get_stage(ss);
+        size_t const    numsegments = stage->num_segments();
+        size_t          emerald     = numsegments;
+        bool            checkpoint  = false;
+        for (size_t sg = 0; sg < numsegments; sg++) {
+            sssegments const* seg = stage->get_segment(sg);
+            for (auto issue : checks(*seg)) {
+                issue.stage   = unsigned(ss);
+                issue.segment = int(sg);
+                found.push_back(issue);
+            }
+            if (emerald != numsegments) {
+                continue;
+            }
+            if (seg->get_type() == sssegments::eChaosEmerald) {
+                emerald = sg;
+            } else if (seg->get_type() == sssegments::eCheckpoint) {
+                checkpoint = true;
+            }
+        }
+
+        validation_issue issue;
+        issue.stage = unsigned(ss);
+        if (emerald == numsegments) {
+            issue.kind = validation_issue::eNoEmerald;
+            found.push_back(issue);
+        } else if (emerald + 1 < numsegments) {
+            issue.kind    = validation_issue::eUnreachable;
+            issue.segment = int(emerald + 1);
+            issue.value   = unsigned(numsegments - emerald - 1);
+            found.push_back(issue);
+        }
+        if (!checkpoint) {
+            issue.kind    = validation_issue::eNoCheckpoint;
+            issue.segment = validation_issue::none;
+            issue.value   = 0;
+            found.push_back(issue);
+        }
+    }
+
+    cache.swap(used);
+    if (found == issues) {
+        return false;
+    }
+    issues.swap(found);
+    return true;
+}
+
+bool stage_validator::clear() {
+    cache.clear();
+    if (issues.empty()) {
+        return false;
+    }
+    issues.clear();
+    return true;
+}
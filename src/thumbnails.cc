@@ -0,0 +1,156 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) Flamewing 2011-2019 <flamewing.sonic@gmail.com>
+ *
+ * S2-SSEdit is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * S2-SSEdit is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "s2ssedit/thumbnails.hh"
+
+#include "s2ssedit/ssobjfile.hh"
+#include "s2ssedit/ssrenderer.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <unordered_set>
+
+using std::atomic;
+using std::cerr;
+using std::endl;
+using std::lock_guard;
+using std::mutex;
+using std::ostringstream;
+using std::setfill;
+using std::setw;
+using std::string;
+using std::thread;
+using std::unique_ptr;
+using std::unordered_set;
+using std::vector;
+
+namespace {
+    struct thumbnail_job {
+        sslevels const* level;
+        unsigned        stage;
+        string          outfile;
+    };
+
+    // Turns a project path into something usable as a file name prefix.
+    string sanitize(string const& dir) {
+        string name;
+        for (char c : dir) {
+            bool keep = (c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z')
+                        || (c >= 'a' && c <= 'z') || c == '-' || c == '_';
+            if (keep) {
+                name.push_back(c);
+            } else if (!name.empty() && name.back() != '_') {
+                name.push_back('_');
+            }
+        }
+        while (!name.empty() && name.back() == '_') {
+            name.pop_back();
+        }
+        return name.empty() ? string("stages") : name;
+    }
+
+    // Different paths can sanitize to the same name, and their jobs would
+    // then write the same files from different threads; later ones get a
+    // numbered suffix that no other project has taken.
+    string unique_name(string const& name, unordered_set<string>& used) {
+        string   result = name;
+        unsigned number = 1;
+        while (!used.insert(result).second) {
+            result = name + '-' + std::to_string(++number);
+        }
+        return result;
+    }
+}    // namespace
+
+size_t render_thumbnails(
+        string const& outdir, vector<string> const& dirs, double scale,
+        string const& ringfile, string const& bombfile) {
+    // Loading is done serially: it is I/O bound and cheap next to rendering.
+    vector<unique_ptr<ssobj_file>> projects;
+    vector<thumbnail_job>          jobs;
+    unordered_set<string>          prefixes;
+    size_t                         failures = 0;
+    for (auto dir : dirs) {
+        if (!dir.empty() && dir.back() != '/') {
+            dir.push_back('/');
+        }
+        auto file = std::make_unique<ssobj_file>(dir);
+        if (!file->good()) {
+            cerr << "Could not load special stages from '" << dir << "'"
+                 << endl;
+            failures++;
+            continue;
+        }
+        string prefix = outdir + '/' + unique_name(sanitize(dir), prefixes);
+        for (unsigned ii = 0; ii < file->num_stages(); ii++) {
+            ostringstream name;
+            name << prefix << "-stage" << setfill('0') << setw(2) << (ii + 1)
+                 << ".png";
+            jobs.push_back(thumbnail_job{file->get_stage(ii), ii, name.str()});
+        }
+        projects.push_back(std::move(file));
+    }
+
+    // Every worker owns its renderer; the levels are only ever read.
+    atomic<size_t> next_job{0};
+    atomic<size_t> failed_jobs{0};
+    mutex          log_mutex;
+    auto           worker = [&]() {
+        unique_ptr<ssrenderer> renderer;
+        try {
+            renderer = std::make_unique<ssrenderer>(ringfile, bombfile);
+        } catch (std::exception const& ex) {
+            lock_guard<mutex> lock(log_mutex);
+            cerr << ex.what() << endl;
+        }
+        for (size_t ii = next_job++; ii < jobs.size(); ii = next_job++) {
+            auto const& job = jobs[ii];
+            try {
+                if (!renderer) {
+                    throw std::runtime_error("Could not load object images");
+                }
+                renderer->set_stage(job.level, job.stage);
+                renderer->render_stage(scale)->write_to_png(job.outfile);
+            } catch (std::exception const& ex) {
+                failed_jobs++;
+                lock_guard<mutex> lock(log_mutex);
+                cerr << job.outfile << ": " << ex.what() << endl;
+            }
+        }
+    };
+
+    size_t num_threads = std::max(1U, thread::hardware_concurrency());
+    num_threads        = std::min(num_threads, jobs.size());
+    vector<thread> threads;
+    threads.reserve(num_threads);
+    for (size_t ii = 0; ii < num_threads; ii++) {
+        threads.emplace_back(worker);
+    }
+    for (auto& th : threads) {
+        th.join();
+    }
+    return failures + failed_jobs;
+}
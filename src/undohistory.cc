@@ -0,0 +1,189 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * Copyright (C) Flamewing 2011-2019 <flamewing.sonic@gmail.com>
+ *
+ * S2-SSEdit is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * S2-SSEdit is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "s2ssedit/undohistory.hh"
+
+#include <utility>
+
+using std::move;
+
+size_t undo_history::record_size(action_arena::record& rec) noexcept {
+    return action_arena::header_size
+           + action_memory_usage(rec.tag, rec.get());
+}
+
+bool undo_history::over_budget() const noexcept {
+    return (budget.max_bytes != 0 && memory_usage() > budget.max_bytes)
+           || (budget.max_steps != 0 && steps.size() > budget.max_steps);
+}
+
+void undo_history::set_limits(limits const& lim) {
+    budget = lim;
+    enforce_limits();
+}
+
+void undo_history::discard_redo() noexcept {
+    while (actions.size() > undo_actions) {
+        actions.pop_back();
+    }
+    steps.resize(undo_count);
+    redo_bytes = 0;
+}
+
+void undo_history::add_newest() {
+    action_arena::record& rec = actions.back();
+    if (undo_count != 0 && steps.back().count == 1) {
+        step&                 last = steps.back();
+        action_arena::record& prev = actions[undo_actions - 1];
+        abstract_action::MergeResult const ret
+                = merge_actions(prev.tag, prev.get(), rec.tag, rec.get());
+        if (ret == abstract_action::eDeleteAction) {
+            actions.pop_back();
+            actions.pop_back();
+            undo_bytes -= last.bytes;
+            steps.pop_back();
+            undo_count--;
+            undo_actions--;
+            return;
+        }
+        if (ret == abstract_action::eMergedActions) {
+            actions.pop_back();
+            size_t const bytes = record_size(prev);
+            undo_bytes         = undo_bytes - last.bytes + bytes;
+            last.bytes         = bytes;
+            enforce_limits();
+            return;
+        }
+    }
+    size_t const bytes = record_size(rec);
+    steps.push_back(step{1, bytes});
+    undo_count++;
+    undo_actions++;
+    undo_bytes += bytes;
+    enforce_limits();
+}
+
+void undo_history::begin() noexcept {
+    if (transaction_depth++ == 0) {
+        discard_redo();
+        queued = 0;
+    }
+}
+
+void undo_history::commit() {
+    if (transaction_depth == 0 || --transaction_depth != 0 || queued == 0) {
+        return;
+    }
+    size_t bytes = 0;
+    for (size_t ii = undo_actions; ii < undo_actions + queued; ii++) {
+        bytes += record_size(actions[ii]);
+    }
+    steps.push_back(step{queued, bytes});
+    undo_count++;
+    undo_actions += queued;
+    undo_bytes += bytes;
+    queued = 0;
+    enforce_limits();
+}
+
+bool undo_history::undo(ssobj_file_shared const& ss, object_set* sel) {
+    if (undo_count == 0 || transaction_depth != 0) {
+        return false;
+    }
+    step const& top = steps[--undo_count];
+    for (size_t ii = 0; ii < top.count; ii++) {
+        action_arena::record& rec = actions[--undo_actions];
+        revert_action(rec.tag, rec.get(), ss, sel);
+        if (journal != nullptr) {
+            journal->append(edit_journal::eRevert, rec);
+        }
+    }
+    undo_bytes -= top.bytes;
+    redo_bytes += top.bytes;
+    return true;
+}
+
+bool undo_history::redo(ssobj_file_shared const& ss, object_set* sel) {
+    if (undo_count == steps.size() || transaction_depth != 0) {
+        return false;
+    }
+    step const& top = steps[undo_count++];
+    for (size_t ii = 0; ii < top.count; ii++) {
+        action_arena::record& rec = actions[undo_actions++];
+        apply_action(rec.tag, rec.get(), ss, sel);
+        if (journal != nullptr) {
+            journal->append(edit_journal::eApply, rec);
+        }
+    }
+    redo_bytes -= top.bytes;
+    undo_bytes += top.bytes;
+    return true;
+}
+
+void undo_history::clear() noexcept {
+    actions.clear();
+    transaction_depth = queued = 0;
+    steps.clear();
+    undo_count = undo_actions = 0;
+    undo_bytes = redo_bytes = 0;
+}
+
+void undo_history::compact() {
+    if (undo_count <= keep_recent) {
+        return;
+    }
+    // Actions are already stored in order, so folding a run of small steps
+    // only has to add up their counts.
+    size_t const     limit = undo_count - keep_recent;
+    std::deque<step> result;
+    size_t           ii = 0;
+    while (ii < limit) {
+        bool const small  = steps[ii].bytes <= small_action;
+        step       merged = steps[ii++];
+        while (small && ii < limit && steps[ii].bytes <= small_action
+               && merged.count + steps[ii].count <= max_group) {
+            merged.count += steps[ii].count;
+            merged.bytes += steps[ii].bytes;
+            ii++;
+        }
+        result.push_back(merged);
+    }
+    undo_count -= limit - result.size();
+    result.insert(result.end(), steps.begin() + long(limit), steps.end());
+    steps.swap(result);
+}
+
+void undo_history::enforce_limits() {
+    if (!over_budget()) {
+        return;
+    }
+    if (budget.compact) {
+        compact();
+    }
+    // Always keep the newest step, so the last edit can be undone.
+    while (over_budget() && undo_count > 1) {
+        step const& oldest = steps.front();
+        for (size_t ii = 0; ii < oldest.count; ii++) {
+            actions.pop_front();
+        }
+        undo_actions -= oldest.count;
+        undo_bytes -= oldest.bytes;
+        undo_count--;
+        steps.pop_front();
+    }
+}